@@ -92,7 +92,9 @@ onready var popups: Dictionary = {
 func _ready() -> void:
 	generator = EngineAudioGenerator.new()
 
+	# Output at the device rate, the model is resampled from its own sample rate
 	stream = player.stream
+	stream.mix_rate = AudioServer.get_mix_rate()
 	playback = player.get_stream_playback()
 
 	generator.stream = stream
@@ -106,17 +108,15 @@ func _ready() -> void:
 
 # Called every frame
 func _process(delta: float) -> void:
-	stream.mix_rate = engine_config.sample_rate
-	
 	# Get generation spacing
 	var sp: float = 1.0 / 60.0
 	var latency: float = 20.0 / 1000.0
 	
 	# Get frames spacing
-	var frames_sp: int = floor(engine_config.sample_rate * sp)
+	var frames_sp: int = floor(stream.mix_rate * sp)
 	
 	# Get spacing
-	sp = frames_sp / float(engine_config.sample_rate)
+	sp = frames_sp / float(stream.mix_rate)
 	
 	# Get playback position
 	var pos: float = player.get_playback_position()
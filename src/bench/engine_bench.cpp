@@ -0,0 +1,371 @@
+// Microbenchmarks for the DSP hot paths, from single kernels up to whole engines.
+// Prints one JSON object per benchmark so results of two builds can be diffed.
+//
+//   engine_bench [--filter <text>] [--min-time <seconds>] [--presets <dir>]
+
+#include "engine_synth.h"
+#include "engine_preset.h"
+#include "engine_utils.h"
+#include "engine_bank_file.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <dirent.h>
+
+#define BENCH_RUNS 5
+#define BENCH_SAMPLE_RATE 44100
+#define BENCH_RPM 3000.f
+
+// Keeps results alive so the kernels aren't optimized away
+static volatile float bench_sink;
+
+class BenchResult {
+public:
+	std::string name;
+	std::string params;
+	uint32_t sample_rate;
+	uint64_t samples;
+	double ns_per_sample;
+	double ns_min;
+};
+
+class BenchRunner {
+public:
+	std::string filter;
+	double min_time;
+
+	// p_run renders p_samples samples, it is called with growing counts until one
+	// call takes a fifth of min_time, then timed BENCH_RUNS times
+	bool matches(const std::string &p_name, const std::string &p_params) const {
+		std::string full_name = p_params.empty() ? p_name : p_name + "/" + p_params;
+		return filter.empty() || full_name.find(filter) != std::string::npos;
+	}
+
+	void run(const std::string &p_name, const std::string &p_params, uint32_t p_sample_rate, const std::function<void(uint32_t)> &p_run) {
+		if (!matches(p_name, p_params)) {
+			return;
+		}
+
+		uint32_t samples = 1024;
+		while (true) {
+			double elapsed = time(p_run, samples);
+			if (elapsed >= min_time / BENCH_RUNS || samples >= (1u << 28)) {
+				break;
+			}
+			samples *= 2;
+		}
+
+		std::vector<double> times;
+		for (int i = 0; i < BENCH_RUNS; i++) {
+			times.push_back(time(p_run, samples));
+		}
+		std::sort(times.begin(), times.end());
+
+		BenchResult result;
+		result.name = p_name;
+		result.params = p_params;
+		result.sample_rate = p_sample_rate;
+		result.samples = samples;
+		result.ns_per_sample = times[BENCH_RUNS / 2] * 1e9 / samples;
+		result.ns_min = times[0] * 1e9 / samples;
+		print(result);
+	}
+
+	static double time(const std::function<void(uint32_t)> &p_run, uint32_t p_samples) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		p_run(p_samples);
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	static void print(const BenchResult &p_result) {
+		// How many streams of this kind one core keeps up with in real time
+		double realtime = 1e9 / (p_result.ns_per_sample * p_result.sample_rate);
+
+		printf("{\"name\": \"%s\", \"params\": \"%s\", \"sample_rate\": %u, \"samples\": %llu, "
+			"\"ns_per_sample\": %.3f, \"ns_min\": %.3f, \"realtime\": %.2f}\n",
+			p_result.name.c_str(), p_result.params.c_str(), p_result.sample_rate,
+			(unsigned long long)p_result.samples, p_result.ns_per_sample, p_result.ns_min, realtime);
+		fflush(stdout);
+	}
+};
+
+static void bench_kernels(BenchRunner &runner) {
+	runner.run("lowpass_filter", "", BENCH_SAMPLE_RATE, [](uint32_t p_samples) {
+		LowPassFilter filter(100.f, BENCH_SAMPLE_RATE);
+		float value = 0.f;
+		for (uint32_t i = 0; i < p_samples; i++) {
+			value = filter.filter((float)(i & 255) - value);
+		}
+		bench_sink = value;
+	});
+
+	// Samples count guide frames, so results compare across guide counts
+	for (uint32_t count : {1u, 8u, 32u}) {
+		runner.run("waveguide_bank", "guides=" + std::to_string(count), BENCH_SAMPLE_RATE, [count](uint32_t p_samples) {
+			WaveGuideBank bank;
+			std::vector<float> max_delays(count, 128.f);
+			std::vector<int32_t> sources(count, -1);
+			bank.modify(count, max_delays.data(), sources.data());
+			for (uint32_t g = 0; g < count; g++) {
+				bank.set_delay(g, 40.f + g * 2.5f);
+				bank.set_reflection(g, 0.5f, -0.5f);
+			}
+			bank.update_min_delay();
+
+			float c1 = 0.f, c0 = 0.f;
+			bool dampened;
+			for (uint32_t i = 0; i < p_samples; i += count) {
+				for (uint32_t g = 0; g < count; g++) {
+					bank.pop(g, c1, c0, dampened);
+					bank.push(g, (float)(i & 15) + c0, c1);
+				}
+			}
+			bench_sink = c1 + c0;
+		});
+
+		runner.run("waveguide_bank_block", "guides=" + std::to_string(count), BENCH_SAMPLE_RATE, [count](uint32_t p_samples) {
+			WaveGuideBank bank;
+			std::vector<float> max_delays(count, 128.f);
+			std::vector<int32_t> sources(count, -1);
+			bank.modify(count, max_delays.data(), sources.data());
+			for (uint32_t g = 0; g < count; g++) {
+				bank.set_delay(g, 40.f + g * 2.5f);
+				bank.set_reflection(g, 0.5f, -0.5f);
+			}
+			bank.update_min_delay();
+
+			uint32_t block = bank.get_max_block();
+			bool dampened;
+			for (uint32_t i = 0; i < p_samples; i += count * block) {
+				for (uint32_t g = 0; g < count; g++) {
+					bank.read_block(g, block, dampened);
+					const float *c1 = bank.get_block_c1(g);
+					const float *c0 = bank.get_block_c0(g);
+					float *in0 = bank.get_block_in0(g);
+					float *in1 = bank.get_block_in1(g);
+					for (uint32_t j = 0; j < block; j++) {
+						in0[j] = c1[j] * 0.5f + (float)(j & 15);
+						in1[j] = c0[j] * -0.5f;
+					}
+					bank.write_block(g, block);
+				}
+			}
+			bench_sink = bank.get_block_c1(0)[0];
+		});
+	}
+
+	runner.run("noise_fill", "", BENCH_SAMPLE_RATE, [](uint32_t p_samples) {
+		CounterNoise noise(NOISE_STREAM_INTAKE);
+		float out[WAVEGUIDE_MAX_BLOCK];
+		for (uint32_t i = 0; i < p_samples; i += WAVEGUIDE_MAX_BLOCK) {
+			noise.fill(out, WAVEGUIDE_MAX_BLOCK);
+		}
+		bench_sink = out[17];
+	});
+
+	// Low passed noise, per sample at 10900 Hz and at a decimated control rate below that
+	for (float freq : {57.f, 204.f, 10900.f}) {
+		runner.run("control_rate_filter", "freq=" + std::to_string((int)freq), BENCH_SAMPLE_RATE, [freq](uint32_t p_samples) {
+			CounterNoise noise(NOISE_STREAM_INTAKE);
+			ControlRateFilter filter(freq, BENCH_SAMPLE_RATE);
+			float out[WAVEGUIDE_MAX_BLOCK];
+			for (uint32_t i = 0; i < p_samples; i += WAVEGUIDE_MAX_BLOCK) {
+				filter.fill(&noise, out, WAVEGUIDE_MAX_BLOCK);
+			}
+			bench_sink = out[17];
+		});
+	}
+
+	// The per sample work of EngineAudioPlayer: converting gathered 16 bit frames
+	// and decoding compressed bank blocks
+	runner.run("pcm16_to_float", "", BENCH_SAMPLE_RATE, [](uint32_t p_samples) {
+		std::vector<int16_t> in(4096);
+		std::vector<float> out(4096);
+		for (uint32_t i = 0; i < in.size(); i++) {
+			in[i] = (int16_t)(i * 37);
+		}
+		for (uint32_t i = 0; i < p_samples; i += 4096) {
+			v_pcm16_to_float(in.data(), out.data(), 4096);
+		}
+		bench_sink = out[17];
+	});
+
+	for (uint32_t channels : {1u, 2u}) {
+		runner.run("adpcm_decode", "channels=" + std::to_string(channels), BENCH_SAMPLE_RATE, [channels](uint32_t p_samples) {
+			uint32_t frames = ENGINE_BANK_ADPCM_BLOCK_FRAMES;
+			std::vector<int16_t> pcm(frames * channels);
+			for (uint32_t i = 0; i < pcm.size(); i++) {
+				pcm[i] = (int16_t)(std::sin(i * 0.05f) * 12000.f);
+			}
+
+			std::vector<uint8_t> block(engine_bank_block_size(channels, frames));
+			uint8_t step_index[2] = {0, 0};
+			engine_adpcm_encode_block(pcm.data(), frames, channels, frames, step_index, block.data());
+
+			for (uint32_t i = 0; i < p_samples; i += frames * channels) {
+				engine_adpcm_decode_block(block.data(), channels, frames, pcm.data());
+			}
+			bench_sink = pcm[3];
+		});
+	}
+}
+
+static EngineParams make_engine_params(uint32_t p_cylinders, uint32_t p_mufflers, uint32_t p_sample_rate) {
+	EnginePreset preset;
+	EngineParams params = preset.params;
+	EngineCylinderParams cylinder = params.cylinders[0];
+
+	params.sample_rate = p_sample_rate;
+	params.cylinders.resize(p_cylinders);
+	for (uint32_t i = 0; i < p_cylinders; i++) {
+		params.cylinders[i] = cylinder;
+		params.cylinders[i].crank_offset = (float)i / (float)p_cylinders;
+	}
+
+	params.muffler_cavity_lengths.resize(p_mufflers);
+	for (uint32_t i = 0; i < p_mufflers; i++) {
+		params.muffler_cavity_lengths[i] = 0.04f + 0.01f * (float)i;
+	}
+
+	return params;
+}
+
+// The engine is built once, the timed runs keep rendering it
+static void bench_synth(BenchRunner &runner, const std::string &p_name, const std::string &p_params, const EngineParams &p_engine_params, float p_rpm, bool p_block_processing) {
+	if (!runner.matches(p_name, p_params)) {
+		return;
+	}
+
+	EngineSynth synth;
+	synth.background_rebuild = false;
+	synth.block_processing = p_block_processing;
+	synth.params = p_engine_params;
+	synth.controls->set_rpm(p_rpm);
+	synth.mark_dirty();
+	synth.clear_buffer();
+
+	runner.run(p_name, p_params, p_engine_params.sample_rate, [&synth](uint32_t p_samples) {
+		float buffer[512];
+		for (uint32_t i = 0; i < p_samples; i += 512) {
+			synth.fill_buffer(buffer, 512, 1);
+		}
+		bench_sink = buffer[0];
+	});
+}
+
+static void bench_engines(BenchRunner &runner) {
+	uint32_t cylinder_counts[] = {1, 2, 4, 6, 8, 12, 16};
+	uint32_t muffler_counts[] = {1, 4, 8};
+	uint32_t sample_rates[] = {22050, 44100, 48000};
+
+	// Only the cylinder lanes of the block renderer, samples count frames
+	for (uint32_t cylinders : {1u, 4u, 16u}) {
+		std::string params = "cylinders=" + std::to_string(cylinders);
+		runner.run("cylinder_block", params, BENCH_SAMPLE_RATE, [cylinders](uint32_t p_samples) {
+			EngineMain engine;
+			engine.build(make_engine_params(cylinders, 1, BENCH_SAMPLE_RATE));
+			CylinderBank *lanes = engine.cylinder_lanes;
+
+			uint32_t crank_phase[WAVEGUIDE_MAX_BLOCK];
+			float noise[WAVEGUIDE_MAX_BLOCK];
+			float collector[WAVEGUIDE_MAX_BLOCK];
+			uint32_t phase = 0;
+			for (uint32_t i = 0; i < p_samples; i += WAVEGUIDE_MAX_BLOCK) {
+				for (uint32_t j = 0; j < WAVEGUIDE_MAX_BLOCK; j++) {
+					phase += crank_to_phase(BENCH_RPM / (60.f * BENCH_SAMPLE_RATE));
+					crank_phase[j] = phase;
+					noise[j] = (float)(j & 15) * 0.01f;
+					collector[j] = lanes->cyl_sound[j * lanes->lanes] * 0.5f;
+				}
+				lanes->process_block(
+					WAVEGUIDE_MAX_BLOCK, crank_phase, crank_phase, noise, collector, collector,
+					engine.intake_valve_shift, engine.exhaust_valve_shift
+				);
+			}
+			bench_sink = lanes->cyl_sound[0];
+		});
+	}
+
+	for (uint32_t sample_rate : sample_rates) {
+		for (uint32_t mufflers : muffler_counts) {
+			for (uint32_t cylinders : cylinder_counts) {
+				std::string params = "cylinders=" + std::to_string(cylinders) +
+					",mufflers=" + std::to_string(mufflers) +
+					",rate=" + std::to_string(sample_rate);
+				bench_synth(runner, "engine_block", params, make_engine_params(cylinders, mufflers, sample_rate), BENCH_RPM, true);
+			}
+		}
+	}
+
+	// Per sample reference path, EngineSynth::gen
+	for (uint32_t cylinders : cylinder_counts) {
+		std::string params = "cylinders=" + std::to_string(cylinders) + ",mufflers=4,rate=44100";
+		bench_synth(runner, "engine_gen", params, make_engine_params(cylinders, 4, BENCH_SAMPLE_RATE), BENCH_RPM, false);
+	}
+}
+
+static void bench_presets(BenchRunner &runner, const std::string &p_dir) {
+	DIR *dir = opendir(p_dir.c_str());
+	if (!dir) {
+		fprintf(stderr, "can't open %s, skipping presets\n", p_dir.c_str());
+		return;
+	}
+
+	std::vector<std::string> files;
+	while (dirent *entry = readdir(dir)) {
+		std::string file = entry->d_name;
+		if (file.size() > 5 && file.compare(file.size() - 5, 5, ".tres") == 0) {
+			files.push_back(file);
+		}
+	}
+	closedir(dir);
+	std::sort(files.begin(), files.end());
+
+	for (const std::string &file : files) {
+		EnginePreset preset;
+		std::string error;
+		if (!engine_preset_load((p_dir + "/" + file).c_str(), preset, error)) {
+			fprintf(stderr, "%s: %s\n", file.c_str(), error.c_str());
+			continue;
+		}
+
+		std::string name = file.substr(0, file.size() - 5);
+		bench_synth(runner, "preset_block", name, preset.params, BENCH_RPM, true);
+		bench_synth(runner, "preset_gen", name, preset.params, BENCH_RPM, false);
+	}
+}
+
+int main(int argc, char **argv) {
+	BenchRunner runner;
+	runner.min_time = 0.25;
+	std::string presets = "project/Engines";
+
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 >= argc) {
+			fprintf(stderr, "usage: engine_bench [--filter <text>] [--min-time <seconds>] [--presets <dir>]\n");
+			return 1;
+		}
+
+		if (strcmp(argv[i], "--filter") == 0) {
+			runner.filter = argv[++i];
+		} else if (strcmp(argv[i], "--min-time") == 0) {
+			runner.min_time = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--presets") == 0) {
+			presets = argv[++i];
+		} else {
+			fprintf(stderr, "usage: engine_bench [--filter <text>] [--min-time <seconds>] [--presets <dir>]\n");
+			return 1;
+		}
+	}
+
+	bench_kernels(runner);
+	bench_engines(runner);
+	bench_presets(runner, presets);
+
+	return 0;
+}
\ No newline at end of file
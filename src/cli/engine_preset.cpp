@@ -0,0 +1,305 @@
+#include "engine_preset.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+typedef std::map<std::string, std::string> PresetProperties;
+
+static std::string trim(const std::string &p_text) {
+	size_t begin = p_text.find_first_not_of(" \t\r\n");
+	if (begin == std::string::npos) {
+		return std::string();
+	}
+	size_t end = p_text.find_last_not_of(" \t\r\n");
+	return p_text.substr(begin, end - begin + 1);
+}
+
+static bool read_line(FILE *p_file, std::string &r_line) {
+	char chunk[1024];
+	r_line.clear();
+
+	while (fgets(chunk, sizeof(chunk), p_file)) {
+		r_line += chunk;
+		if (!r_line.empty() && r_line[r_line.size() - 1] == '\n') {
+			return true;
+		}
+	}
+
+	return !r_line.empty();
+}
+
+// Collects the properties of the [sub_resource] sections by id and those of [resource],
+// values are kept as written. Arrays may continue over several lines.
+static bool parse_tres(FILE *p_file, std::map<int, PresetProperties> &r_sub_resources, PresetProperties &r_resource, std::string &r_error) {
+	PresetProperties *section = nullptr;
+	bool has_resource = false;
+	std::string line;
+
+	while (read_line(p_file, line)) {
+		line = trim(line);
+		if (line.empty() || line[0] == ';') {
+			continue;
+		}
+
+		if (line[0] == '[') {
+			section = nullptr;
+
+			if (line.compare(0, 14, "[sub_resource ") == 0) {
+				size_t id = line.find(" id=");
+				if (id == std::string::npos) {
+					r_error = "sub_resource without an id";
+					return false;
+				}
+				section = &r_sub_resources[atoi(line.c_str() + id + 4)];
+			} else if (line == "[resource]") {
+				section = &r_resource;
+				has_resource = true;
+			}
+			continue;
+		}
+
+		size_t equals = line.find('=');
+		if (!section || equals == std::string::npos) {
+			continue;
+		}
+
+		std::string value = trim(line.substr(equals + 1));
+		if (!value.empty() && value[0] == '[') {
+			std::string more;
+			while (value.find(']') == std::string::npos && read_line(p_file, more)) {
+				value += " " + trim(more);
+			}
+		}
+
+		(*section)[trim(line.substr(0, equals))] = value;
+	}
+
+	if (!has_resource) {
+		r_error = "no [resource] section, not a text resource";
+		return false;
+	}
+
+	return true;
+}
+
+static void read_float(const PresetProperties &p_properties, const char *p_name, float &r_value) {
+	PresetProperties::const_iterator it = p_properties.find(p_name);
+	if (it != p_properties.end()) {
+		r_value = strtof(it->second.c_str(), nullptr);
+	}
+}
+
+static void read_uint(const PresetProperties &p_properties, const char *p_name, uint32_t &r_value) {
+	PresetProperties::const_iterator it = p_properties.find(p_name);
+	if (it != p_properties.end()) {
+		r_value = (uint32_t)strtoul(it->second.c_str(), nullptr, 10);
+	}
+}
+
+static void read_int(const PresetProperties &p_properties, const char *p_name, int &r_value) {
+	PresetProperties::const_iterator it = p_properties.find(p_name);
+	if (it != p_properties.end()) {
+		r_value = atoi(it->second.c_str());
+	}
+}
+
+static void read_bool(const PresetProperties &p_properties, const char *p_name, bool &r_value) {
+	PresetProperties::const_iterator it = p_properties.find(p_name);
+	if (it != p_properties.end()) {
+		r_value = it->second == "true";
+	}
+}
+
+// Resolves an array of SubResource( id ) references, false when the property is missing
+static bool read_elements(const PresetProperties &p_properties, const char *p_name, const std::map<int, PresetProperties> &p_sub_resources, std::vector<const PresetProperties *> &r_elements, std::string &r_error) {
+	PresetProperties::const_iterator it = p_properties.find(p_name);
+	if (it == p_properties.end()) {
+		return false;
+	}
+
+	const std::string &value = it->second;
+	if (value.find("ExtResource") != std::string::npos) {
+		r_error = std::string(p_name) + " references another file, only sub resources are supported";
+		return false;
+	}
+
+	size_t pos = 0;
+	while ((pos = value.find("SubResource(", pos)) != std::string::npos) {
+		pos += 12;
+		int id = atoi(value.c_str() + pos);
+
+		std::map<int, PresetProperties>::const_iterator sub = p_sub_resources.find(id);
+		if (sub == p_sub_resources.end()) {
+			r_error = std::string(p_name) + " references a missing sub resource";
+			return false;
+		}
+		r_elements.push_back(&sub->second);
+	}
+
+	return true;
+}
+
+bool engine_preset_load(const char *p_path, EnginePreset &r_preset, std::string &r_error) {
+	FILE *file = fopen(p_path, "rb");
+	if (!file) {
+		r_error = std::string("can't open ") + p_path;
+		return false;
+	}
+
+	std::map<int, PresetProperties> sub_resources;
+	PresetProperties resource;
+	bool parsed = parse_tres(file, sub_resources, resource, r_error);
+	fclose(file);
+
+	if (!parsed) {
+		return false;
+	}
+
+	PresetProperties::const_iterator name = resource.find("resource_name");
+	if (name != resource.end() && name->second.size() >= 2) {
+		r_preset.name = name->second.substr(1, name->second.size() - 2);
+	}
+
+	EngineParams &params = r_preset.params;
+
+	read_float(resource, "rpm", r_preset.controls.rpm);
+	read_float(resource, "volume", r_preset.controls.volume);
+	read_float(resource, "intake_volume", r_preset.controls.intake_volume);
+	read_float(resource, "exhaust_volume", r_preset.controls.exhaust_volume);
+	read_float(resource, "vibrations_volume", r_preset.controls.vibrations_volume);
+	read_float(resource, "dc_filter_frequency", r_preset.dc_filter_frequency);
+	read_uint(resource, "sample_rate", params.sample_rate);
+	read_uint(resource, "output_sample_rate", r_preset.output_sample_rate);
+	read_int(resource, "resampler_quality", r_preset.resampler_quality);
+	read_bool(resource, "block_processing", r_preset.block_processing);
+	read_float(resource, "max_pipe_length", params.max_pipe_length);
+
+	read_float(resource, "vibrations_filter_frequency", params.vibrations_filter_frequency);
+	read_float(resource, "intake_noise_factor", params.intake_noise_factor);
+	read_float(resource, "intake_noise_filter_frequency", params.intake_noise_filter_frequency);
+	read_float(resource, "intake_valve_shift", params.intake_valve_shift);
+	read_float(resource, "exhaust_valve_shift", params.exhaust_valve_shift);
+	read_float(resource, "crankshaft_fluctuation", params.crankshaft_fluctuation);
+	read_float(resource, "crankshaft_fluctuation_filter_frequency", params.crankshaft_fluctuation_filter_frequency);
+	read_uint(resource, "intake_noise_seed", params.intake_noise_seed);
+	read_uint(resource, "crankshaft_noise_seed", params.crankshaft_noise_seed);
+
+	read_float(resource, "straight_pipe_extractor_side_refl", params.straight_pipe_extractor_side_refl);
+	read_float(resource, "straight_pipe_muffler_side_refl", params.straight_pipe_muffler_side_refl);
+	read_float(resource, "straight_pipe_length", params.straight_pipe_length);
+	read_float(resource, "output_side_refl", params.output_side_refl);
+
+	read_float(resource, "cylinder_intake_opened_refl", params.cylinder_intake_opened_refl);
+	read_float(resource, "cylinder_intake_closed_refl", params.cylinder_intake_closed_refl);
+	read_float(resource, "cylinder_exhaust_opened_refl", params.cylinder_exhaust_opened_refl);
+	read_float(resource, "cylinder_exhaust_closed_refl", params.cylinder_exhaust_closed_refl);
+	read_float(resource, "cylinder_intake_open_end_refl", params.cylinder_intake_open_end_refl);
+	read_float(resource, "cylinder_extractor_open_end_refl", params.cylinder_extractor_open_end_refl);
+
+	std::vector<const PresetProperties *> elements;
+	if (read_elements(resource, "muffler_elements_output", sub_resources, elements, r_error)) {
+		params.muffler_cavity_lengths.resize(elements.size());
+
+		for (size_t i = 0; i < elements.size(); i++) {
+			params.muffler_cavity_lengths[i] = 0.04f;
+			read_float(*elements[i], "cavity_length", params.muffler_cavity_lengths[i]);
+		}
+	} else if (!r_error.empty()) {
+		return false;
+	}
+
+	elements.clear();
+	if (read_elements(resource, "cylinder_elements", sub_resources, elements, r_error)) {
+		params.cylinders.resize(elements.size());
+
+		for (size_t i = 0; i < elements.size(); i++) {
+			EngineCylinderParams &cyl = params.cylinders[i];
+			cyl.piston_motion_factor = 2.43f;
+			cyl.ignition_factor = 5.f;
+			cyl.ignition_time = 0.1f;
+			cyl.intake_pipe_length = 0.08f;
+			cyl.exhaust_pipe_length = 0.1f;
+			cyl.extractor_pipe_length = 0.1f;
+			cyl.crank_offset = 0.0f;
+
+			read_float(*elements[i], "piston_motion_factor", cyl.piston_motion_factor);
+			read_float(*elements[i], "ignition_factor", cyl.ignition_factor);
+			read_float(*elements[i], "ignition_time", cyl.ignition_time);
+			read_float(*elements[i], "intake_pipe_length", cyl.intake_pipe_length);
+			read_float(*elements[i], "exhaust_pipe_length", cyl.exhaust_pipe_length);
+			read_float(*elements[i], "extractor_pipe_length", cyl.extractor_pipe_length);
+			read_float(*elements[i], "crank_offset", cyl.crank_offset);
+		}
+	} else if (!r_error.empty()) {
+		return false;
+	}
+
+	if (params.cylinders.empty()) {
+		r_error = "the preset has no cylinders";
+		return false;
+	}
+
+	return true;
+}
+
+void EnginePreset::apply(EngineSynth *p_synth) const {
+	p_synth->params = params;
+	p_synth->controls->state = controls;
+	p_synth->controls->publish();
+	p_synth->dc_filter_frequency = dc_filter_frequency;
+	p_synth->output_sample_rate = output_sample_rate;
+	p_synth->resampler_quality = resampler_quality;
+	p_synth->block_processing = block_processing;
+	p_synth->mark_dirty();
+}
+
+EnginePreset::EnginePreset() {
+	controls.rpm = 1000.f;
+	controls.volume = 0.5f;
+	controls.intake_volume = 0.5f;
+	controls.exhaust_volume = 0.25f;
+	controls.vibrations_volume = 0.1f;
+	dc_filter_frequency = 0.5f;
+	output_sample_rate = 0;
+	resampler_quality = RESAMPLER_QUALITY_MEDIUM;
+	block_processing = true;
+
+	params.sample_rate = 20050;
+	params.max_pipe_length = 4.0f;
+
+	params.vibrations_filter_frequency = 92.0f;
+	params.intake_noise_factor = 0.2f;
+	params.intake_noise_filter_frequency = 10900.0f;
+	params.intake_valve_shift = 0.04f;
+	params.exhaust_valve_shift = 0.0f;
+	params.crankshaft_fluctuation = 0.3f;
+	params.crankshaft_fluctuation_filter_frequency = 57.0f;
+
+	params.straight_pipe_extractor_side_refl = 0.06f;
+	params.straight_pipe_muffler_side_refl = 0.0f;
+	params.straight_pipe_length = 2.0f;
+	params.output_side_refl = -0.14f;
+	params.muffler_cavity_lengths = {0.04f, 0.06f, 0.07f, 0.09f};
+
+	params.cylinder_intake_opened_refl = 0.04f;
+	params.cylinder_intake_closed_refl = 1.0f;
+	params.cylinder_exhaust_opened_refl = 0.0f;
+	params.cylinder_exhaust_closed_refl = 0.7f;
+	params.cylinder_intake_open_end_refl = -0.75f;
+	params.cylinder_extractor_open_end_refl = 0.0f;
+
+	float crank_offsets[] = {0.f / 8.f, 1.5f / 8.f, 2.5f / 8.f, 4.f / 8.f};
+	params.cylinders.resize(4);
+	for (uint32_t i = 0; i < 4; i++) {
+		EngineCylinderParams &cyl = params.cylinders[i];
+		cyl.piston_motion_factor = 2.43f;
+		cyl.ignition_factor = 5.f;
+		cyl.ignition_time = 0.1f;
+		cyl.intake_pipe_length = 0.08f;
+		cyl.exhaust_pipe_length = 0.1f;
+		cyl.extractor_pipe_length = 0.1f;
+		cyl.crank_offset = crank_offsets[i];
+	}
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef ENGINE_PRESET_H
+#define ENGINE_PRESET_H
+
+#include <string>
+#include "engine_synth.h"
+
+// An EngineConfig resource read without Godot. Properties missing from the file keep
+// the values an EngineConfig is constructed with, like they do when Godot loads it.
+class EnginePreset {
+public:
+	std::string name;
+	EngineParams params;
+	EngineControlState controls;
+	float dc_filter_frequency;
+	uint32_t output_sample_rate;
+	int resampler_quality;
+	bool block_processing;
+
+	// Copies everything into the synth and marks its engine for a rebuild
+	void apply(EngineSynth *p_synth) const;
+
+	EnginePreset();
+	~EnginePreset() {}
+};
+
+// Loads the text resources the editor saves, project/Engines/*.tres. Cylinders and
+// mufflers have to be sub resources of the same file.
+bool engine_preset_load(const char *p_path, EnginePreset &r_preset, std::string &r_error);
+
+#endif // ENGINE_PRESET_H
\ No newline at end of file
@@ -0,0 +1,296 @@
+// Renders an engine preset to a WAV file without Godot, for build machines and
+// profiling runs.
+//
+//   engine_render [options] <preset.tres> <output.wav>
+
+#include "engine_synth.h"
+#include "engine_preset.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#define RENDER_CONTROL_FRAMES 256
+#define RENDER_DEFAULT_SECONDS 5.0f
+
+// Rpm automation, linear between points and held before the first and after the last
+class RpmCurve {
+public:
+	std::vector<float> times;
+	std::vector<float> rpms;
+
+	void add(float p_time, float p_rpm) {
+		size_t i = times.size();
+		while (i > 0 && times[i - 1] > p_time) {
+			i--;
+		}
+		times.insert(times.begin() + i, p_time);
+		rpms.insert(rpms.begin() + i, p_rpm);
+	}
+
+	float get(float p_time) const {
+		if (p_time <= times[0]) {
+			return rpms[0];
+		}
+
+		for (size_t i = 1; i < times.size(); i++) {
+			if (p_time < times[i]) {
+				float t = (p_time - times[i - 1]) / (times[i] - times[i - 1]);
+				return rpms[i - 1] + (rpms[i] - rpms[i - 1]) * t;
+			}
+		}
+
+		return rpms[rpms.size() - 1];
+	}
+};
+
+static void print_usage() {
+	fprintf(stderr,
+		"usage: engine_render [options] <preset.tres> <output.wav>\n"
+		"  --rpm <t:rpm,...>     rpm automation points in seconds, linear in between\n"
+		"  --rpm-file <path>     the same as one \"seconds rpm\" pair per line\n"
+		"  --duration <seconds>  defaults to the last automation point, or 5 seconds\n"
+		"  --sample-rate <hz>    engine sample rate, defaults to the preset's\n"
+		"  --output-rate <hz>    resamples the output\n"
+		"  --channels <n>        output channels, the engine is mono (default 1)\n"
+		"  --seed <n>            fixed noise seeds, n for the intake and n + 1 for the crankshaft\n"
+	);
+}
+
+// "0:800,2.5:6000,4:800"
+static bool parse_rpm_points(const char *p_text, RpmCurve &r_curve) {
+	const char *pos = p_text;
+
+	while (*pos) {
+		char *end;
+		float time = strtof(pos, &end);
+		if (end == pos || *end != ':') {
+			return false;
+		}
+
+		pos = end + 1;
+		float rpm = strtof(pos, &end);
+		if (end == pos) {
+			return false;
+		}
+		r_curve.add(time, rpm);
+
+		pos = end;
+		if (*pos == ',') {
+			pos++;
+		} else if (*pos) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool load_rpm_file(const char *p_path, RpmCurve &r_curve) {
+	FILE *file = fopen(p_path, "r");
+	if (!file) {
+		return false;
+	}
+
+	char line[256];
+	while (fgets(line, sizeof(line), file)) {
+		float time, rpm;
+		if (line[0] == '#' || sscanf(line, "%f %f", &time, &rpm) != 2) {
+			continue;
+		}
+		r_curve.add(time, rpm);
+	}
+
+	fclose(file);
+	return true;
+}
+
+static void put_u16(uint8_t *p_out, uint16_t p_value) {
+	p_out[0] = (uint8_t)p_value;
+	p_out[1] = (uint8_t)(p_value >> 8);
+}
+
+static void put_u32(uint8_t *p_out, uint32_t p_value) {
+	put_u16(p_out, (uint16_t)p_value);
+	put_u16(p_out + 2, (uint16_t)(p_value >> 16));
+}
+
+// 16 bit PCM, the same layout EngineAudioRecorder exports
+static bool write_wav_header(FILE *p_file, uint32_t p_sample_rate, uint32_t p_channels, uint32_t p_frames) {
+	uint8_t header[44];
+	uint32_t data_size = p_frames * p_channels * 2;
+
+	memcpy(header, "RIFF", 4);
+	put_u32(header + 4, 36 + data_size);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	put_u32(header + 16, 16);
+	put_u16(header + 20, 1);
+	put_u16(header + 22, (uint16_t)p_channels);
+	put_u32(header + 24, p_sample_rate);
+	put_u32(header + 28, p_sample_rate * 2 * p_channels);
+	put_u16(header + 32, (uint16_t)(2 * p_channels));
+	put_u16(header + 34, 16);
+	memcpy(header + 36, "data", 4);
+	put_u32(header + 40, data_size);
+
+	return fwrite(header, 1, sizeof(header), p_file) == sizeof(header);
+}
+
+int main(int argc, char **argv) {
+	const char *preset_path = nullptr;
+	const char *output_path = nullptr;
+	RpmCurve curve;
+	float duration = 0.f;
+	uint32_t sample_rate = 0;
+	uint32_t output_rate = 0;
+	int channels = 1;
+	uint32_t seed = 0;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (arg[0] != '-') {
+			if (!preset_path) {
+				preset_path = arg;
+			} else if (!output_path) {
+				output_path = arg;
+			} else {
+				print_usage();
+				return 1;
+			}
+			continue;
+		}
+
+		if (!value) {
+			print_usage();
+			return 1;
+		}
+		i++;
+
+		if (strcmp(arg, "--rpm") == 0) {
+			if (!parse_rpm_points(value, curve)) {
+				fprintf(stderr, "invalid rpm points: %s\n", value);
+				return 1;
+			}
+		} else if (strcmp(arg, "--rpm-file") == 0) {
+			if (!load_rpm_file(value, curve)) {
+				fprintf(stderr, "can't open %s\n", value);
+				return 1;
+			}
+		} else if (strcmp(arg, "--duration") == 0) {
+			duration = strtof(value, nullptr);
+		} else if (strcmp(arg, "--sample-rate") == 0) {
+			sample_rate = (uint32_t)strtoul(value, nullptr, 10);
+		} else if (strcmp(arg, "--output-rate") == 0) {
+			output_rate = (uint32_t)strtoul(value, nullptr, 10);
+		} else if (strcmp(arg, "--channels") == 0) {
+			channels = atoi(value);
+		} else if (strcmp(arg, "--seed") == 0) {
+			seed = (uint32_t)strtoul(value, nullptr, 10);
+		} else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	if (!preset_path || !output_path || channels < 1 || channels > 8) {
+		print_usage();
+		return 1;
+	}
+
+	EnginePreset preset;
+	std::string error;
+	if (!engine_preset_load(preset_path, preset, error)) {
+		fprintf(stderr, "%s: %s\n", preset_path, error.c_str());
+		return 1;
+	}
+
+	if (sample_rate > 0) {
+		preset.params.sample_rate = sample_rate;
+	}
+	if (output_rate > 0) {
+		preset.output_sample_rate = output_rate;
+	}
+	if (seed > 0) {
+		preset.params.intake_noise_seed = seed;
+		preset.params.crankshaft_noise_seed = seed + 1;
+	}
+	if (curve.times.empty()) {
+		curve.add(0.f, preset.controls.rpm);
+	}
+	if (duration <= 0.f) {
+		duration = curve.times[curve.times.size() - 1];
+		if (duration <= 0.f) {
+			duration = RENDER_DEFAULT_SECONDS;
+		}
+	}
+
+	// Built here, the renderer below is the only thread
+	EngineSynth *synth = new EngineSynth();
+	synth->background_rebuild = false;
+	preset.apply(synth);
+	synth->clear_buffer();
+
+	if (!synth->update_engine()) {
+		fprintf(stderr, "%s: the engine could not be built\n", preset_path);
+		delete synth;
+		return 1;
+	}
+
+	uint32_t rate = preset.output_sample_rate > 0 ? preset.output_sample_rate : preset.params.sample_rate;
+	uint32_t total_frames = (uint32_t)std::ceil(duration * (float)rate);
+
+	FILE *file = fopen(output_path, "wb");
+	if (!file || !write_wav_header(file, rate, (uint32_t)channels, total_frames)) {
+		fprintf(stderr, "can't write %s\n", output_path);
+		if (file) {
+			fclose(file);
+		}
+		delete synth;
+		return 1;
+	}
+
+	std::vector<float> buffer(RENDER_CONTROL_FRAMES * channels);
+	std::vector<uint8_t> pcm(RENDER_CONTROL_FRAMES * channels * 2);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Rpm follows the curve at control rate, like a game updating it every frame
+	uint32_t frame = 0;
+	while (frame < total_frames) {
+		uint32_t frames = total_frames - frame < RENDER_CONTROL_FRAMES ? total_frames - frame : RENDER_CONTROL_FRAMES;
+		uint32_t values = frames * channels;
+
+		synth->controls->set_rpm(curve.get((float)frame / (float)rate));
+		synth->fill_buffer(buffer.data(), (int)frames, channels);
+
+		for (uint32_t i = 0; i < values; i++) {
+			float sample = buffer[i] * 32767.f;
+			sample = sample < -32768.f ? -32768.f : (sample > 32767.f ? 32767.f : sample);
+			put_u16(pcm.data() + i * 2, (uint16_t)(int16_t)sample);
+		}
+
+		if (fwrite(pcm.data(), 2, values, file) != values) {
+			fprintf(stderr, "can't write %s\n", output_path);
+			fclose(file);
+			delete synth;
+			return 1;
+		}
+
+		frame += frames;
+	}
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fclose(file);
+
+	fprintf(stderr, "%s: %.2f s rendered in %.3f s, %.1fx realtime\n",
+		preset.name.empty() ? preset_path : preset.name.c_str(),
+		duration, elapsed, elapsed > 0.0 ? duration / elapsed : 0.0);
+
+	delete synth;
+	return 0;
+}
\ No newline at end of file
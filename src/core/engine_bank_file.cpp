@@ -0,0 +1,326 @@
+#include "engine_bank_file.h"
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Written to disk as is, so its layout can't depend on the compiler
+static_assert(sizeof(EngineBankHeader) == 80, "EngineBankHeader has padding");
+static_assert(sizeof(EngineBankIndexEntry) == 16, "EngineBankIndexEntry has padding");
+
+static const char engine_bank_magic[8] = {'E', 'N', 'G', 'B', 'A', 'N', 'K', '1'};
+
+static inline uint64_t align_up(uint64_t p_offset, uint64_t p_align) {
+	return (p_offset + p_align - 1) / p_align * p_align;
+}
+
+static const int8_t adpcm_index_table[16] = {
+	-1, -1, -1, -1, 2, 4, 6, 8,
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int16_t adpcm_step_table[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+	253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+	1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+	3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+	12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+// Applies one code to the decoder state, the encoder runs the same to stay in step
+static inline void adpcm_apply(int &p_predictor, int &p_index, int p_code) {
+	int step = adpcm_step_table[p_index];
+	int diff = step >> 3;
+	if (p_code & 1) diff += step >> 2;
+	if (p_code & 2) diff += step >> 1;
+	if (p_code & 4) diff += step;
+	if (p_code & 8) diff = -diff;
+
+	p_predictor += diff;
+	p_predictor = p_predictor < -32768 ? -32768 : (p_predictor > 32767 ? 32767 : p_predictor);
+	p_index += adpcm_index_table[p_code];
+	p_index = p_index < 0 ? 0 : (p_index > 88 ? 88 : p_index);
+}
+
+uint32_t engine_bank_checksum(const void *p_data, size_t p_size, uint32_t p_hash) {
+	const uint8_t *bytes = (const uint8_t *)p_data;
+	for (size_t i = 0; i < p_size; i++) {
+		p_hash = (p_hash ^ bytes[i]) * 16777619u;
+	}
+	return p_hash;
+}
+
+void engine_bank_init_header(EngineBankHeader &p_header, uint32_t p_sample_rate, uint32_t p_channels, uint32_t p_sample_count, uint32_t p_frame_count,
+		uint32_t p_codec, uint32_t p_block_frames, uint32_t p_block_count) {
+	memset(&p_header, 0, sizeof(EngineBankHeader));
+	memcpy(p_header.magic, engine_bank_magic, sizeof(engine_bank_magic));
+
+	p_header.version = ENGINE_BANK_VERSION;
+	p_header.header_size = sizeof(EngineBankHeader);
+	p_header.sample_rate = p_sample_rate;
+	p_header.channels = (uint16_t)p_channels;
+	p_header.stem_count = ENGINE_BANK_STEMS;
+	p_header.sample_count = p_sample_count;
+	p_header.frame_count = p_frame_count;
+	p_header.codec = (uint16_t)p_codec;
+	p_header.block_frames = (uint16_t)p_block_frames;
+	p_header.block_count = p_block_count;
+
+	p_header.index_offset = align_up(sizeof(EngineBankHeader), ENGINE_BANK_INDEX_ALIGN);
+
+	uint64_t offset = p_header.index_offset + (uint64_t)p_sample_count * sizeof(EngineBankIndexEntry);
+	for (int i = 0; i < ENGINE_BANK_STEMS; i++) {
+		offset = align_up(offset, ENGINE_BANK_DATA_ALIGN);
+		p_header.stem_offsets[i] = offset;
+		offset += engine_bank_stem_size(p_header);
+	}
+}
+
+uint64_t engine_bank_stem_size(const EngineBankHeader &p_header) {
+	if (p_header.codec == ENGINE_BANK_CODEC_ADPCM) {
+		return (uint64_t)p_header.block_count * engine_bank_block_size(p_header.channels, p_header.block_frames);
+	}
+	return (uint64_t)p_header.frame_count * p_header.channels * sizeof(int16_t);
+}
+
+uint32_t engine_bank_block_size(uint32_t p_channels, uint32_t p_block_frames) {
+	return p_channels * 4 + p_channels * p_block_frames / 2;
+}
+
+uint32_t engine_bank_header_checksum(const EngineBankHeader &p_header, const EngineBankIndexEntry *p_index) {
+	EngineBankHeader header = p_header;
+	header.header_checksum = 0;
+
+	uint32_t hash = engine_bank_checksum(&header, sizeof(EngineBankHeader));
+	return engine_bank_checksum(p_index, (size_t)p_header.sample_count * sizeof(EngineBankIndexEntry), hash);
+}
+
+const EngineBankHeader *engine_bank_validate(const uint8_t *p_data, size_t p_size, bool p_check_data) {
+	if (!p_data || p_size < sizeof(EngineBankHeader)) return nullptr;
+
+	const EngineBankHeader *header = (const EngineBankHeader *)p_data;
+	if (memcmp(header->magic, engine_bank_magic, sizeof(engine_bank_magic)) != 0) return nullptr;
+	if (header->version != ENGINE_BANK_VERSION || header->header_size != sizeof(EngineBankHeader)) return nullptr;
+	if (header->stem_count != ENGINE_BANK_STEMS || header->channels < 1 || header->channels > 2) return nullptr;
+
+	bool adpcm = header->codec == ENGINE_BANK_CODEC_ADPCM;
+	uint32_t block_frames = header->block_frames;
+	if (header->codec != ENGINE_BANK_CODEC_PCM16 && !adpcm) return nullptr;
+	if (adpcm && (block_frames < 2 || (block_frames & (block_frames - 1)) != 0)) return nullptr;
+
+	uint64_t index_size = (uint64_t)header->sample_count * sizeof(EngineBankIndexEntry);
+	if (header->index_offset % ENGINE_BANK_INDEX_ALIGN != 0 || header->index_offset < sizeof(EngineBankHeader)) return nullptr;
+	// Offsets come from the file, compare against what is left so nothing can wrap around
+	if (header->index_offset > p_size || index_size > p_size - header->index_offset) return nullptr;
+
+	uint64_t stem_size = engine_bank_stem_size(*header);
+	for (int i = 0; i < ENGINE_BANK_STEMS; i++) {
+		uint64_t offset = header->stem_offsets[i];
+		if (offset % ENGINE_BANK_DATA_ALIGN != 0 || offset < header->index_offset + index_size) return nullptr;
+		if (offset > p_size || stem_size > p_size - offset) return nullptr;
+	}
+
+	const EngineBankIndexEntry *index = (const EngineBankIndexEntry *)(p_data + header->index_offset);
+	if (engine_bank_header_checksum(*header, index) != header->header_checksum) return nullptr;
+
+	// Frames are read in place, so samples can't point outside of them
+	for (uint32_t i = 0; i < header->sample_count; i++) {
+		if (!(index[i].rpm > 0) || index[i].end <= index[i].start || index[i].end > header->frame_count) return nullptr;
+
+		if (adpcm) {
+			uint64_t blocks = (index[i].end - index[i].start + block_frames - 1) / block_frames;
+			if ((uint64_t)index[i].block + blocks > header->block_count) return nullptr;
+		}
+	}
+
+	if (p_check_data) {
+		uint32_t hash = engine_bank_checksum(nullptr, 0);
+		for (int i = 0; i < ENGINE_BANK_STEMS; i++) {
+			hash = engine_bank_checksum(p_data + header->stem_offsets[i], (size_t)stem_size, hash);
+		}
+		if (hash != header->data_checksum) return nullptr;
+	}
+
+	return header;
+}
+
+void engine_adpcm_encode_block(const int16_t *p_in, uint32_t p_frames, uint32_t p_channels, uint32_t p_block_frames, uint8_t *p_step_index, uint8_t *p_out) {
+	int predictor[2];
+	int index[2];
+
+	// The block starts on the exact first sample so errors can't carry over
+	for (uint32_t c = 0; c < p_channels; c++) {
+		predictor[c] = p_in[c];
+		index[c] = p_step_index[c];
+
+		uint8_t *header = p_out + c * 4;
+		header[0] = (uint8_t)(predictor[c] & 0xff);
+		header[1] = (uint8_t)((predictor[c] >> 8) & 0xff);
+		header[2] = (uint8_t)index[c];
+		header[3] = 0;
+	}
+
+	uint8_t *codes = p_out + p_channels * 4;
+	memset(codes, 0, p_channels * p_block_frames / 2);
+
+	for (uint32_t f = 0; f < p_block_frames; f++) {
+		const int16_t *frame = p_in + (f < p_frames ? f : p_frames - 1) * p_channels;
+
+		for (uint32_t c = 0; c < p_channels; c++) {
+			int diff = frame[c] - predictor[c];
+			int step = adpcm_step_table[index[c]];
+			int code = 0;
+
+			if (diff < 0) {
+				code = 8;
+				diff = -diff;
+			}
+			if (diff >= step) {
+				code |= 4;
+				diff -= step;
+			}
+			step >>= 1;
+			if (diff >= step) {
+				code |= 2;
+				diff -= step;
+			}
+			step >>= 1;
+			if (diff >= step) {
+				code |= 1;
+			}
+
+			adpcm_apply(predictor[c], index[c], code);
+
+			uint32_t n = f * p_channels + c;
+			codes[n >> 1] |= (uint8_t)(code << ((n & 1) * 4));
+		}
+	}
+
+	for (uint32_t c = 0; c < p_channels; c++) {
+		p_step_index[c] = (uint8_t)index[c];
+	}
+}
+
+void engine_adpcm_decode_block(const uint8_t *p_in, uint32_t p_channels, uint32_t p_block_frames, int16_t *p_out) {
+	int predictor[2];
+	int index[2];
+
+	for (uint32_t c = 0; c < p_channels; c++) {
+		const uint8_t *header = p_in + c * 4;
+		predictor[c] = (int16_t)(header[0] | (header[1] << 8));
+		index[c] = header[2] > 88 ? 88 : header[2];
+	}
+
+	const uint8_t *codes = p_in + p_channels * 4;
+	uint32_t bytes = p_block_frames * p_channels / 2;
+
+	if (p_channels == 1) {
+		for (uint32_t n = 0; n < bytes; n++) {
+			adpcm_apply(predictor[0], index[0], codes[n] & 0xf);
+			p_out[n * 2] = (int16_t)predictor[0];
+			adpcm_apply(predictor[0], index[0], codes[n] >> 4);
+			p_out[n * 2 + 1] = (int16_t)predictor[0];
+		}
+	} else {
+		// A stereo frame fills a byte, both channels decode side by side
+		for (uint32_t n = 0; n < bytes; n++) {
+			adpcm_apply(predictor[0], index[0], codes[n] & 0xf);
+			adpcm_apply(predictor[1], index[1], codes[n] >> 4);
+			p_out[n * 2] = (int16_t)predictor[0];
+			p_out[n * 2 + 1] = (int16_t)predictor[1];
+		}
+	}
+}
+
+bool EngineMappedFile::open(const char *p_path) {
+	close();
+
+#ifdef _WIN32
+	wchar_t path[MAX_PATH];
+	if (MultiByteToWideChar(CP_UTF8, 0, p_path, -1, path, MAX_PATH) == 0) return false;
+
+	HANDLE file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	file_handle = file;
+	mapping_handle = mapping;
+	data = (const uint8_t *)view;
+	size = (size_t)file_size.QuadPart;
+#else
+	int fd = ::open(p_path, O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	// The mapping stays valid after the descriptor is closed
+	void *view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED) return false;
+
+	data = (const uint8_t *)view;
+	size = (size_t)st.st_size;
+#endif
+
+	return true;
+}
+
+void EngineMappedFile::close() {
+	if (!data) return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle((HANDLE)mapping_handle);
+	CloseHandle((HANDLE)file_handle);
+	file_handle = nullptr;
+	mapping_handle = nullptr;
+#else
+	munmap((void *)data, size);
+#endif
+
+	data = nullptr;
+	size = 0;
+}
+
+EngineMappedFile::EngineMappedFile() {
+	this->data = nullptr;
+	this->size = 0;
+#ifdef _WIN32
+	this->file_handle = nullptr;
+	this->mapping_handle = nullptr;
+#endif
+}
+
+EngineMappedFile::~EngineMappedFile() {
+	close();
+}
\ No newline at end of file
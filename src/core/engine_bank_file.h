@@ -0,0 +1,95 @@
+#ifndef ENGINE_BANK_FILE_H
+#define ENGINE_BANK_FILE_H
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+Engine bank container, version 1. Little endian, offsets are in bytes from the start of the file.
+	Header - EngineBankHeader
+	Index - one EngineBankIndexEntry per sample sorted by rpm, 16 byte aligned
+	Stems - crankshaft, ignition and exhaust, each 64 byte aligned and holding frame_count
+		frames of interleaved 16 bit PCM. Sample start and end offsets are in frames.
+		IMA-ADPCM stems hold block_count blocks instead. Every sample starts a new block
+		at its index entry's block, so any frame decodes from a single block.
+The header checksum covers the header, with header_checksum zeroed, and the index. It is
+checked on every load. The data checksum covers the stems in order, checking it reads the
+whole file so it is left to callers that read the file anyway.
+*/
+
+#define ENGINE_BANK_VERSION 1
+#define ENGINE_BANK_STEMS 3
+#define ENGINE_BANK_INDEX_ALIGN 16
+#define ENGINE_BANK_DATA_ALIGN 64
+
+#define ENGINE_BANK_CODEC_PCM16 0
+#define ENGINE_BANK_CODEC_ADPCM 1
+#define ENGINE_BANK_ADPCM_BLOCK_FRAMES 256
+
+struct EngineBankHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t sample_rate;
+	uint16_t channels;
+	uint16_t stem_count;
+	uint32_t sample_count;
+	uint32_t frame_count;
+	uint64_t index_offset;
+	uint64_t stem_offsets[ENGINE_BANK_STEMS];
+	uint32_t header_checksum;
+	uint32_t data_checksum;
+	uint16_t codec;
+	// ADPCM frames per block, a power of two
+	uint16_t block_frames;
+	uint32_t block_count;
+};
+
+struct EngineBankIndexEntry {
+	float rpm;
+	uint32_t start;
+	uint32_t end;
+	// First ADPCM block of the sample
+	uint32_t block;
+};
+
+// FNV-1a, pass the previous result to continue over more data
+uint32_t engine_bank_checksum(const void *p_data, size_t p_size, uint32_t p_hash = 2166136261u);
+
+// Fills in the identifier and the layout, checksums are left zero
+void engine_bank_init_header(EngineBankHeader &p_header, uint32_t p_sample_rate, uint32_t p_channels, uint32_t p_sample_count, uint32_t p_frame_count,
+		uint32_t p_codec = ENGINE_BANK_CODEC_PCM16, uint32_t p_block_frames = 0, uint32_t p_block_count = 0);
+uint64_t engine_bank_stem_size(const EngineBankHeader &p_header);
+uint32_t engine_bank_block_size(uint32_t p_channels, uint32_t p_block_frames);
+uint32_t engine_bank_header_checksum(const EngineBankHeader &p_header, const EngineBankIndexEntry *p_index);
+
+// Returns the header of a complete bank file in memory, nullptr if it is not one
+const EngineBankHeader *engine_bank_validate(const uint8_t *p_data, size_t p_size, bool p_check_data);
+
+// IMA-ADPCM blocks. Each channel starts with its predictor and step index, followed by
+// 4 bit codes for the interleaved samples, low nibble first. p_step_index carries the
+// encoder's step index per channel from one block to the next. Frames past p_frames are
+// padded with the last frame.
+void engine_adpcm_encode_block(const int16_t *p_in, uint32_t p_frames, uint32_t p_channels, uint32_t p_block_frames, uint8_t *p_step_index, uint8_t *p_out);
+void engine_adpcm_decode_block(const uint8_t *p_in, uint32_t p_channels, uint32_t p_block_frames, int16_t *p_out);
+
+// Read only view of a whole file, mapped into memory so nothing gets copied
+class EngineMappedFile {
+public:
+	const uint8_t *data;
+	size_t size;
+
+#ifdef _WIN32
+	void *file_handle;
+	void *mapping_handle;
+#endif
+
+	// p_path is an absolute UTF-8 path
+	bool open(const char *p_path);
+	void close();
+
+	EngineMappedFile();
+	~EngineMappedFile();
+};
+
+#endif // ENGINE_BANK_FILE_H
\ No newline at end of file
@@ -0,0 +1,1304 @@
+#include "engine_parts.h"
+#include "engine_utils.h"
+
+#define WAVEGUIDE_MAX_AMP 20.0f
+
+static inline void dampen_sample(float sample, float &value, bool &dampened) {
+	float sample_abs = std::abs(sample);
+	if (sample_abs > WAVEGUIDE_MAX_AMP) {
+		value = (sample < 0.0f ? -1.0f : 1.0f) *
+			(-1.0f / (sample_abs - WAVEGUIDE_MAX_AMP + 1.0f) + 1.0f + WAVEGUIDE_MAX_AMP);
+		dampened = true;
+	} else {
+		value = sample;
+		dampened = false;
+	}
+}
+
+static void seed_noise(CounterNoise *noise, uint32_t seed, uint32_t stream) {
+	if (seed) {
+		noise->set_seed(seed, stream);
+	} else {
+		noise->set_random_seed(stream);
+	}
+}
+
+void id(uint32_t id, char id_char) {
+	for (uint32_t i = 0; i < id; i++) {
+		std::cout << id_char;
+	}
+}
+
+void EngineMain::build(const EngineParams &params) {
+	uint32_t sample_rate = params.sample_rate;
+
+	intake_noise_factor = params.intake_noise_factor;
+	intake_valve_shift = crank_to_phase(params.intake_valve_shift);
+	exhaust_valve_shift = crank_to_phase(params.exhaust_valve_shift);
+	crankshaft_fluctuation = params.crankshaft_fluctuation;
+
+	if (!intake_noise) {
+		intake_noise = new CounterNoise(NOISE_STREAM_INTAKE);
+	}
+	if (!crankshaft_noise) {
+		crankshaft_noise = new CounterNoise(NOISE_STREAM_CRANKSHAFT);
+	}
+
+	if (params.intake_noise_seed != intake_noise_seed) {
+		intake_noise_seed = params.intake_noise_seed;
+		seed_noise(intake_noise, intake_noise_seed, NOISE_STREAM_INTAKE);
+	}
+	if (params.crankshaft_noise_seed != crankshaft_noise_seed) {
+		crankshaft_noise_seed = params.crankshaft_noise_seed;
+		seed_noise(crankshaft_noise, crankshaft_noise_seed, NOISE_STREAM_CRANKSHAFT);
+	}
+	
+	if (!intake_noise_lp) {
+		intake_noise_lp = new ControlRateFilter(params.intake_noise_filter_frequency, sample_rate);
+	} else {
+		intake_noise_lp->modify(params.intake_noise_filter_frequency, sample_rate);
+	}
+
+	if (!vibration_filter) {
+		vibration_filter = new LowPassFilter(params.vibrations_filter_frequency, sample_rate);
+	} else {
+		vibration_filter->modify(params.vibrations_filter_frequency, sample_rate);
+	}
+
+	if (!crankshaft_fluctuation_lp) {
+		crankshaft_fluctuation_lp = new ControlRateFilter(params.crankshaft_fluctuation_filter_frequency, sample_rate);
+	} else {
+		crankshaft_fluctuation_lp->modify(params.crankshaft_fluctuation_filter_frequency, sample_rate);
+	}
+
+	if (!waveguides) {
+		waveguides = new WaveGuideBank();
+	}
+	if (!muffler) {
+		muffler = new EngineMuffler();
+	}
+
+	uint32_t cylinder_count = params.cylinders.size();
+	size_t prev_cylinder_count = cylinders.size();
+	uint32_t muffler_count = params.muffler_cavity_lengths.size();
+	size_t prev_muffler_count = muffler->muffler_elements.size();
+	bool prev_built = waveguides->count > 0;
+
+	// Waveguides are laid out as intake, exhaust and extractor of each cylinder,
+	// then the straight pipe and the muffler elements
+	uint32_t waveguide_count = cylinder_count * 3 + 1 + muffler_count;
+	waveguide_delays.resize(waveguide_count);
+	waveguide_max_delays.resize(waveguide_count);
+	waveguide_sources.assign(waveguide_count, -1);
+
+	// Build cylinders
+	{
+		if (cylinder_count < prev_cylinder_count) {
+			for (uint32_t i = cylinder_count; i < prev_cylinder_count; i++) {
+				delete cylinders[i];
+			}
+		}
+
+		cylinders.resize(cylinder_count, nullptr);
+
+		for (uint32_t i = 0; i < cylinder_count; i++) {
+			const EngineCylinderParams &cyl_params = params.cylinders[i];
+
+			EngineCylinder *cyl = nullptr;
+
+			if (i < prev_cylinder_count) {
+				cyl = cylinders[i];
+			}
+
+			bool new_cylinder = !cyl;
+
+			if (cyl) {
+				waveguide_sources[i * 3 + 0] = (int32_t)cyl->intake_waveguide;
+				waveguide_sources[i * 3 + 1] = (int32_t)cyl->exhaust_waveguide;
+				waveguide_sources[i * 3 + 2] = (int32_t)cyl->extractor_waveguide;
+			} else {
+				cyl = new EngineCylinder();
+			}
+
+			cyl->piston_motion_factor = cyl_params.piston_motion_factor;
+			cyl->ignition_factor = cyl_params.ignition_factor;
+			cyl->crank_offset = crank_to_phase(cyl_params.crank_offset);
+
+			// The ignition window only changes with the ignition time
+			if (new_cylinder || cyl->ignition_time != cyl_params.ignition_time) {
+				cyl->ignition_time = cyl_params.ignition_time;
+				ignition_window(cyl->ignition_time, cyl->ignition_window_len, cyl->ignition_window_scale);
+			}
+			cyl->intake_open_refl = params.cylinder_intake_opened_refl;
+			cyl->intake_closed_refl = params.cylinder_intake_closed_refl;
+			cyl->exhaust_open_refl = params.cylinder_exhaust_opened_refl;
+			cyl->exhaust_closed_refl = params.cylinder_exhaust_closed_refl;
+
+			cyl->intake_waveguide = i * 3 + 0;
+			cyl->exhaust_waveguide = i * 3 + 1;
+			cyl->extractor_waveguide = i * 3 + 2;
+
+			waveguide_delays[cyl->intake_waveguide] = distance_to_delay(cyl_params.intake_pipe_length, sample_rate);
+			waveguide_delays[cyl->exhaust_waveguide] = distance_to_delay(cyl_params.exhaust_pipe_length, sample_rate);
+			waveguide_delays[cyl->extractor_waveguide] = distance_to_delay(cyl_params.extractor_pipe_length, sample_rate);
+
+			cylinders[i] = cyl;
+		}
+	}
+
+	// Build mufflers
+	{
+		uint32_t straight_pipe = cylinder_count * 3;
+
+		if (prev_built) {
+			waveguide_sources[straight_pipe] = (int32_t)muffler->straight_pipe;
+		}
+		muffler->straight_pipe = straight_pipe;
+		waveguide_delays[straight_pipe] = distance_to_delay(params.straight_pipe_length, sample_rate);
+
+		muffler->muffler_elements.resize(muffler_count, 0);
+
+		for (uint32_t i = 0; i < muffler_count; i++) {
+			uint32_t muf = straight_pipe + 1 + i;
+
+			if (prev_built && i < prev_muffler_count) {
+				waveguide_sources[muf] = (int32_t)muffler->muffler_elements[i];
+			}
+			muffler->muffler_elements[i] = muf;
+			waveguide_delays[muf] = distance_to_delay(params.muffler_cavity_lengths[i], sample_rate);
+		}
+	}
+
+	// Build waveguides
+	{
+		// Every delay line can grow up to max_pipe_length without being reallocated
+		float max_delay = distance_to_delay(params.max_pipe_length, sample_rate);
+		for (uint32_t i = 0; i < waveguide_count; i++) {
+			waveguide_max_delays[i] = waveguide_delays[i] > max_delay ? waveguide_delays[i] : max_delay;
+		}
+
+		waveguides->modify(waveguide_count, waveguide_max_delays.data(), waveguide_sources.data());
+
+		// Whole samples keep the tuning of the integer delay lines, and an exact
+		// delay line needs no interpolation to damp the highs
+		for (uint32_t i = 0; i < waveguide_count; i++) {
+			waveguides->set_delay(i, std::floor(waveguide_delays[i]));
+		}
+		waveguides->update_min_delay();
+
+		for (uint32_t i = 0; i < cylinder_count; i++) {
+			EngineCylinder *cyl = cylinders[i];
+
+			waveguides->set_reflection(cyl->intake_waveguide, 1.0f, params.cylinder_intake_open_end_refl);
+			waveguides->set_reflection(cyl->exhaust_waveguide, 0.71f, 0.06f);
+			waveguides->set_reflection(cyl->extractor_waveguide, 0.0f, params.cylinder_extractor_open_end_refl);
+		}
+
+		waveguides->set_reflection(muffler->straight_pipe, params.straight_pipe_extractor_side_refl, params.straight_pipe_muffler_side_refl);
+
+		for (uint32_t i = 0; i < muffler_count; i++) {
+			waveguides->set_reflection(muffler->muffler_elements[i], 0.0f, params.output_side_refl);
+		}
+	}
+
+	// Cylinder lanes for the block renderer
+	{
+		if (!cylinder_lanes) {
+			cylinder_lanes = new CylinderBank();
+		}
+		cylinder_lanes->resize(cylinder_count);
+
+		for (uint32_t i = 0; i < cylinder_count; i++) {
+			cylinder_lanes->set_cylinder(i, cylinders[i], waveguides);
+		}
+	}
+}
+
+void EngineMain::clear() {
+	crankshaft_phase = 0;
+	noise_pos = 0.0;
+	exhaust_collector = 0.0;
+	intake_collector = 0.0;
+
+	if (intake_noise_seed) {
+		intake_noise->seek(0);
+	}
+	if (crankshaft_noise_seed) {
+		crankshaft_noise->seek(0);
+	}
+
+	size_t cylinder_count = cylinders.size();
+	for (size_t i = 0; i < cylinder_count; i++) {
+		cylinders[i]->clear();
+	}
+
+	waveguides->clear();
+	intake_noise_lp->clear();
+	vibration_filter->clear();
+
+	crankshaft_fluctuation_lp->clear();
+}
+
+void EngineMain::debug_print() {
+	// std::cout << "Intake volume: " << intake_volume << std::endl;
+	// std::cout << "Exhaust volume: " << exhaust_volume << std::endl;
+	// std::cout << "Vibrations volume: " << vibrations_volume << std::endl;
+	
+	std::cout << "Intake noise factor: " << intake_noise_factor << std::endl;
+	std::cout << "Intake valve shift: " << phase_to_crank(intake_valve_shift) << std::endl;
+	std::cout << "Exhaust valve shift: " << phase_to_crank(exhaust_valve_shift) << std::endl;
+	std::cout << "Crankshaft fluctuation: " << crankshaft_fluctuation << std::endl;
+	
+	std::cout << "Crankshaft pos: " << phase_to_crank(crankshaft_phase) << std::endl;
+	std::cout << "Exhaust collector: " << exhaust_collector << std::endl;
+	std::cout << "Intake collector: " << intake_collector << std::endl;
+
+	std::cout << "Number of cylinders: " << cylinders.size() << std::endl;
+	for (uint32_t i = 0; i < cylinders.size(); i++) {
+		std::cout << "Cylinder N " << i << ": " << std::endl;
+		cylinders[i]->debug_print(waveguides, 1);
+	}
+
+	std::cout << "Muffler: " << std::endl;
+	muffler->debug_print(waveguides, 1);
+}
+
+void EngineCylinder::pop(
+	WaveGuideBank *waveguides,
+	uint32_t crank_phase, float exhaust_collector, uint32_t intake_valve_shift, uint32_t exhaust_valve_shift, 
+	float &intake, float &exhaust, float &piston_sound, bool &waveguide_dampened
+) {
+	uint32_t crank = crank_phase + crank_offset;
+
+	cyl_sound = piston_motion_phase(crank) * piston_motion_factor
+		+ fuel_ignition_phase(crank, ignition_window_len, ignition_window_scale) * ignition_factor;
+
+	float ex_valve = exhaust_valve_phase(crank + exhaust_valve_shift);
+	float in_valve = intake_valve_phase(crank + intake_valve_shift);
+
+	waveguides->alpha[exhaust_waveguide] = exhaust_closed_refl
+		+ (exhaust_open_refl - exhaust_closed_refl) * ex_valve;
+	waveguides->alpha[intake_waveguide] = intake_closed_refl
+		+ (intake_open_refl - intake_closed_refl) * in_valve;
+	
+	float ex_c1, ex_c0;
+	bool ex_dampened;
+	waveguides->pop(exhaust_waveguide, ex_c1, ex_c0, ex_dampened);
+
+	float in_c1, in_c0;
+	bool in_dampened;
+	waveguides->pop(intake_waveguide, in_c1, in_c0, in_dampened);
+
+	float ext_c1, ext_c0;
+	bool ext_dampened;
+	waveguides->pop(extractor_waveguide, ext_c1, ext_c0, ext_dampened);
+
+	extractor_exhaust = ext_c1;
+	waveguides->push(extractor_waveguide, ex_c0, exhaust_collector);
+	
+	intake = in_c0;
+	exhaust = ext_c0;
+	piston_sound = cyl_sound;
+	waveguide_dampened = ex_dampened || in_dampened || ext_dampened;
+}
+
+void EngineCylinder::push(WaveGuideBank *waveguides, float intake) {
+	float ex_in = (1.0f - std::abs(waveguides->alpha[exhaust_waveguide])) * cyl_sound * 0.5f;
+	waveguides->push(exhaust_waveguide, ex_in, extractor_exhaust);
+
+	float in_in = (1.0f - std::abs(waveguides->alpha[intake_waveguide])) * cyl_sound * 0.5f;
+	waveguides->push(intake_waveguide, in_in, intake);
+}
+
+void EngineCylinder::clear() {
+	cyl_sound = 0;
+	extractor_exhaust = 0;
+}
+
+void EngineCylinder::debug_print(WaveGuideBank *waveguides, uint32_t indent) {
+	id(indent, ' ');
+	std::cout << "Crank offset: " << phase_to_crank(crank_offset) << std::endl;
+	
+	id(indent, ' ');
+	std::cout << "Intake open refl: " << intake_open_refl << std::endl;
+
+	id(indent, ' ');
+	std::cout << "Intake closed refl: " << intake_closed_refl << std::endl;
+
+	id(indent, ' ');
+	std::cout << "Exhaust open refl: " << exhaust_open_refl << std::endl;
+
+	id(indent, ' ');
+	std::cout << "Exhaust closed refl: " << exhaust_closed_refl << std::endl;
+
+	id(indent, ' ');
+	std::cout << "Piston motion factor: " << piston_motion_factor << std::endl;
+
+	id(indent, ' ');
+	std::cout << "Ignition factor: " << ignition_factor << std::endl;
+
+	id(indent, ' ');
+	std::cout << "Ignition time: " << ignition_time << std::endl;
+
+	id(indent, ' ');
+	std::cout << "Cyl sound: " << cyl_sound << std::endl;
+
+	id(indent, ' ');
+	std::cout << "Extractor exhaust: " << extractor_exhaust << std::endl;
+
+	id(indent, ' ');
+	std::cout << "Exhaust waveguide: " << std::endl;
+	waveguides->debug_print(exhaust_waveguide, indent + 1);
+
+	id(indent, ' ');
+	std::cout << "Intake waveguide: " << std::endl;
+	waveguides->debug_print(intake_waveguide, indent + 1);
+
+	id(indent, ' ');
+	std::cout << "Extractor waveguide: " << std::endl;
+	waveguides->debug_print(extractor_waveguide, indent + 1);
+}
+
+void EngineMuffler::debug_print(WaveGuideBank *waveguides, uint32_t indent) {
+	id(indent, ' ');
+	std::cout << "Muffler count: " << muffler_elements.size() << std::endl;
+	for (uint32_t i = 0; i < muffler_elements.size(); i++) {
+		std::cout << "Muffler N " << i << ": " << std::endl;
+		waveguides->debug_print(muffler_elements[i], 1);
+	}
+
+	id(indent, ' ');
+	std::cout << "Straight pipe: " << std::endl;
+	waveguides->debug_print(straight_pipe, indent + 1);
+}
+
+float LowPassFilter::filter(float sample) {
+	float ret = (sample - last) * alpha + last;
+	last = ret;
+	return ret;
+}
+
+void LowPassFilter::modify(float freq, uint32_t sample_rate) {
+	this->delay = 1.0f / freq;
+	this->alpha = ((float)ENGINE_PI * 2 * (1.0f / sample_rate) * freq) /
+		((float)ENGINE_PI * 2 * (1.0f / sample_rate) * freq + 1);
+}
+
+void LowPassFilter::clear() {
+	last = 0;
+}
+
+void ControlRateFilter::advance(CounterNoise *noise) {
+	from = to;
+	to = filter.filter(noise->next_f32() * gain);
+	slope = (to - from) / (float)decimation;
+}
+
+float ControlRateFilter::next(CounterNoise *noise) {
+	if (decimation == 1) {
+		return filter.filter(noise->next_f32());
+	}
+
+	if (step == 0) {
+		advance(noise);
+	}
+
+	step++;
+	float value = from + slope * (float)step;
+	if (step == decimation) {
+		step = 0;
+	}
+	return value;
+}
+
+void ControlRateFilter::fill(CounterNoise *noise, float *p_out, uint32_t p_count) {
+	if (decimation == 1) {
+		noise->fill(p_out, p_count);
+		for (uint32_t i = 0; i < p_count; i++) {
+			p_out[i] = filter.filter(p_out[i]);
+		}
+		return;
+	}
+
+	uint32_t i = 0;
+	while (i < p_count) {
+		if (step == 0) {
+			advance(noise);
+		}
+
+		uint32_t frames = decimation - step;
+		frames = frames < p_count - i ? frames : p_count - i;
+
+		for (uint32_t j = 0; j < frames; j++) {
+			p_out[i + j] = from + slope * (float)(step + j + 1);
+		}
+
+		step = (step + frames) % decimation;
+		i += frames;
+	}
+}
+
+void ControlRateFilter::modify(float freq, uint32_t sample_rate) {
+	uint32_t new_decimation = 1;
+	while (new_decimation < NOISE_MAX_DECIMATION &&
+		(float)sample_rate / (float)(new_decimation * 2) >= freq * NOISE_CONTROL_OVERSAMPLING) {
+		new_decimation *= 2;
+	}
+
+	// Holds the current value and continues from it at the next control step
+	if (new_decimation != decimation) {
+		float current = decimation == 1 ? filter.last : from + slope * (float)step;
+		filter.last = current;
+		from = current;
+		to = current;
+		slope = 0.0f;
+		step = 0;
+		decimation = new_decimation;
+	}
+
+	filter.modify(freq, sample_rate / decimation);
+
+	// White noise at a lower rate has more power below the cutoff, scale it so the
+	// filtered level matches the per sample filter
+	LowPassFilter full_rate(freq, sample_rate);
+	gain = std::sqrt((full_rate.alpha / (2.0f - full_rate.alpha)) * ((2.0f - filter.alpha) / filter.alpha));
+}
+
+void ControlRateFilter::copy_state(const ControlRateFilter *other) {
+	if (other->decimation != decimation) {
+		return;
+	}
+
+	filter.last = other->filter.last;
+	from = other->from;
+	to = other->to;
+	slope = other->slope;
+	step = other->step;
+}
+
+void ControlRateFilter::clear() {
+	filter.clear();
+	from = 0.0f;
+	to = 0.0f;
+	slope = 0.0f;
+	step = 0;
+}
+
+// Ring index of the sample pushed delay_int frames ago
+static inline uint32_t delay_read_pos(uint32_t pos, uint32_t capacity, uint32_t delay) {
+	uint32_t read_pos = pos + capacity - delay;
+	return read_pos >= capacity ? read_pos - capacity : read_pos;
+}
+
+void WaveGuideBank::pop(uint32_t guide, float &c1, float &c0, bool &dampened) {
+	uint32_t guide_capacity = capacity[guide];
+	uint32_t a = delay_read_pos(pos[guide], guide_capacity, delay_int[guide]);
+	uint32_t b = a == 0 ? guide_capacity - 1 : a - 1;
+
+	const float *guide_data = data + offset[guide];
+	const float *frame_a = guide_data + a * 2;
+	const float *frame_b = guide_data + b * 2;
+	float frac = delay_frac[guide];
+
+	float _c1, _c0;
+	bool _c1_dampened, _c0_dampened;
+	dampen_sample(frame_a[1] + (frame_b[1] - frame_a[1]) * frac, _c1, _c1_dampened);
+	dampen_sample(frame_a[0] + (frame_b[0] - frame_a[0]) * frac, _c0, _c0_dampened);
+
+	c1_out[guide] = _c1;
+	c0_out[guide] = _c0;
+
+	c1 = _c1 * (1.0f - std::abs(alpha[guide]));
+	c0 = _c0 * (1.0f - std::abs(beta[guide]));
+	dampened = _c1_dampened || _c0_dampened;
+}
+
+void WaveGuideBank::push(uint32_t guide, float x0_in, float x1_in) {
+	float *frame = data + offset[guide] + pos[guide] * 2;
+
+	frame[0] = c1_out[guide] * alpha[guide] + x0_in;
+	frame[1] = c0_out[guide] * beta[guide] + x1_in;
+
+	uint32_t next_pos = pos[guide] + 1;
+	pos[guide] = next_pos == capacity[guide] ? 0 : next_pos;
+}
+
+void WaveGuideBank::set_reflection(uint32_t guide, float alpha, float beta) {
+	this->alpha[guide] = alpha;
+	this->beta[guide] = beta;
+}
+
+void WaveGuideBank::set_delay(uint32_t guide, float delay) {
+	float max_delay = get_max_delay(guide);
+	delay = delay < 1.0f ? 1.0f : (delay > max_delay ? max_delay : delay);
+
+	delay_int[guide] = (uint32_t)delay;
+	delay_frac[guide] = delay - (float)delay_int[guide];
+}
+
+void WaveGuideBank::update_min_delay() {
+	min_delay = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		min_delay = (i == 0 || delay_int[i] < min_delay) ? delay_int[i] : min_delay;
+	}
+}
+
+uint32_t WaveGuideBank::get_max_block() const {
+	uint32_t max_block = min_delay > 1 ? min_delay : 1;
+	return max_block < WAVEGUIDE_MAX_BLOCK ? max_block : WAVEGUIDE_MAX_BLOCK;
+}
+
+static inline void write_span(float *frames, const float *in0, const float *in1, uint32_t stride, uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		frames[i * 2 + 0] = in0[i * stride];
+		frames[i * 2 + 1] = in1[i * stride];
+	}
+}
+
+void WaveGuideBank::read_block(uint32_t guide, uint32_t frames, bool &dampened) {
+	read_block(guide, frames, get_block_c1(guide), get_block_c0(guide), 1, dampened);
+}
+
+void WaveGuideBank::read_block(uint32_t guide, uint32_t frames, float *c1, float *c0, uint32_t stride, bool &dampened) {
+	const float *guide_data = data + offset[guide];
+	uint32_t guide_capacity = capacity[guide];
+	float frac = delay_frac[guide];
+
+	// The block is never longer than the delay, every tap was written before it
+	uint32_t a = delay_read_pos(pos[guide], guide_capacity, delay_int[guide]);
+	uint32_t b = a == 0 ? guide_capacity - 1 : a - 1;
+
+	bool block_dampened = false;
+	for (uint32_t i = 0; i < frames; i++) {
+		const float *frame_a = guide_data + a * 2;
+		const float *frame_b = guide_data + b * 2;
+
+		bool c1_dampened, c0_dampened;
+		dampen_sample(frame_a[1] + (frame_b[1] - frame_a[1]) * frac, c1[i * stride], c1_dampened);
+		dampen_sample(frame_a[0] + (frame_b[0] - frame_a[0]) * frac, c0[i * stride], c0_dampened);
+		block_dampened = block_dampened || c1_dampened || c0_dampened;
+
+		b = a;
+		a = a + 1 == guide_capacity ? 0 : a + 1;
+	}
+
+	c1_out[guide] = c1[(frames - 1) * stride];
+	c0_out[guide] = c0[(frames - 1) * stride];
+
+	dampened = block_dampened;
+}
+
+void WaveGuideBank::write_block(uint32_t guide, uint32_t frames) {
+	write_block(guide, frames, get_block_in0(guide), get_block_in1(guide), 1);
+}
+
+void WaveGuideBank::write_block(uint32_t guide, uint32_t frames, const float *in0, const float *in1, uint32_t stride) {
+	float *guide_data = data + offset[guide];
+	uint32_t guide_capacity = capacity[guide];
+
+	uint32_t write_pos = pos[guide];
+
+	// At most one wrap around, the block is shorter than the delay line
+	uint32_t head = guide_capacity - write_pos;
+	head = head < frames ? head : frames;
+
+	write_span(guide_data + write_pos * 2, in0, in1, stride, head);
+	write_span(guide_data, in0 + head * stride, in1 + head * stride, stride, frames - head);
+
+	pos[guide] = (write_pos + frames) % guide_capacity;
+}
+
+// Room for the delay and the interpolation tap behind it, rounded so that every
+// delay line fills whole cache lines
+static inline uint32_t delay_capacity(float max_delay) {
+	max_delay = max_delay > 1.0f ? max_delay : 1.0f;
+	return align_count((uint32_t)max_delay + 2, CACHE_LINE_SIZE / sizeof(float) / 2);
+}
+
+void WaveGuideBank::modify(uint32_t count, const float *max_delays, const int32_t *sources) {
+	// Same layout, nothing to move around
+	if (this->data && count == this->count) {
+		bool same_layout = true;
+		for (uint32_t i = 0; i < count && same_layout; i++) {
+			same_layout = sources[i] == (int32_t)i && delay_capacity(max_delays[i]) == this->capacity[i];
+		}
+		if (same_layout) return;
+	}
+
+	const uint32_t line_floats = CACHE_LINE_SIZE / sizeof(float);
+
+	uint32_t new_stride = align_count(count > 0 ? count : 1, line_floats);
+	uint32_t new_data_len = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		new_data_len += delay_capacity(max_delays[i]) * 2;
+	}
+
+	// Per guide state shares one allocation, each array starting on its own cache line
+	uint8_t *state = (uint8_t *)aligned_malloc(new_stride * sizeof(float) * 9);
+	float *new_data = (float *)aligned_malloc(new_data_len * sizeof(float));
+	float *new_block_data = (float *)aligned_malloc(count * WAVEGUIDE_MAX_BLOCK * 4 * sizeof(float));
+
+	uint32_t *new_offset = (uint32_t *)state;
+	uint32_t *new_capacity = new_offset + new_stride;
+	uint32_t *new_pos = new_capacity + new_stride;
+	uint32_t *new_delay_int = new_pos + new_stride;
+	float *new_delay_frac = (float *)(new_delay_int + new_stride);
+	float *new_alpha = new_delay_frac + new_stride;
+	float *new_beta = new_alpha + new_stride;
+	float *new_c1_out = new_beta + new_stride;
+	float *new_c0_out = new_c1_out + new_stride;
+
+	uint32_t off = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t guide_capacity = delay_capacity(max_delays[i]);
+		float *guide_data = new_data + off;
+
+		new_offset[i] = off;
+		new_capacity[i] = guide_capacity;
+
+		for (uint32_t j = 0; j < guide_capacity * 2; j++) {
+			guide_data[j] = 0.0f;
+		}
+
+		int32_t src = sources[i];
+		if (this->data && src >= 0 && (uint32_t)src < this->count) {
+			const float *src_data = this->data + this->offset[src];
+			uint32_t src_capacity = this->capacity[src];
+			uint32_t src_pos = this->pos[src];
+			uint32_t kept = src_capacity < guide_capacity ? src_capacity : guide_capacity;
+
+			// Keep the most recent samples, the new write position starts at zero
+			for (uint32_t k = 1; k <= kept; k++) {
+				uint32_t from = (src_pos + src_capacity - k) % src_capacity;
+				uint32_t to = guide_capacity - k;
+
+				guide_data[to * 2 + 0] = src_data[from * 2 + 0];
+				guide_data[to * 2 + 1] = src_data[from * 2 + 1];
+			}
+
+			uint32_t max_delay_int = guide_capacity - 1;
+			new_pos[i] = 0;
+			new_delay_int[i] = this->delay_int[src] < max_delay_int ? this->delay_int[src] : max_delay_int;
+			new_delay_frac[i] = this->delay_int[src] < max_delay_int ? this->delay_frac[src] : 0.0f;
+			new_alpha[i] = this->alpha[src];
+			new_beta[i] = this->beta[src];
+			new_c1_out[i] = this->c1_out[src];
+			new_c0_out[i] = this->c0_out[src];
+		} else {
+			new_pos[i] = 0;
+			new_delay_int[i] = 1;
+			new_delay_frac[i] = 0.0f;
+			new_alpha[i] = 0.0f;
+			new_beta[i] = 0.0f;
+			new_c1_out[i] = 0.0f;
+			new_c0_out[i] = 0.0f;
+		}
+
+		off += guide_capacity * 2;
+	}
+
+	if (this->data) {
+		aligned_free(this->data);
+		aligned_free(this->block_data);
+		aligned_free(this->offset);
+	}
+
+	uint32_t new_min_delay = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		new_min_delay = (i == 0 || new_delay_int[i] < new_min_delay) ? new_delay_int[i] : new_min_delay;
+	}
+
+	this->count = count;
+	this->stride = new_stride;
+	this->data_len = new_data_len;
+	this->min_delay = new_min_delay;
+	this->data = new_data;
+	this->block_data = new_block_data;
+	this->offset = new_offset;
+	this->capacity = new_capacity;
+	this->pos = new_pos;
+	this->delay_int = new_delay_int;
+	this->delay_frac = new_delay_frac;
+	this->alpha = new_alpha;
+	this->beta = new_beta;
+	this->c1_out = new_c1_out;
+	this->c0_out = new_c0_out;
+}
+
+void WaveGuideBank::clear() {
+	for (uint32_t i = 0; i < data_len; i++) {
+		data[i] = 0;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		pos[i] = 0;
+		c1_out[i] = 0;
+		c0_out[i] = 0;
+	}
+}
+
+void WaveGuideBank::debug_print(uint32_t guide, uint32_t indent) {
+	id(indent, ' ');
+	std::cout << "Alpha: " << alpha[guide] << std::endl;
+
+	id(indent, ' ');
+	std::cout << "Beta: " << beta[guide] << std::endl;
+
+	id(indent, ' ');
+	std::cout << "C1 out: " << c1_out[guide] << std::endl;
+
+	id(indent, ' ');
+	std::cout << "C0 out: " << c0_out[guide] << std::endl;
+
+	id(indent, ' ');
+	std::cout << "Capacity: " << capacity[guide] << std::endl;
+
+	id(indent, ' ');
+	std::cout << "Delay: " << get_delay(guide) << std::endl;
+
+	id(indent, ' ');
+	std::cout << "Position: " << pos[guide] << std::endl;
+}
+
+void CylinderBank::set_cylinder(uint32_t i, EngineCylinder *cylinder, WaveGuideBank *waveguides) {
+	crank_offset[i] = cylinder->crank_offset;
+	piston_motion_factor[i] = cylinder->piston_motion_factor;
+	ignition_factor[i] = cylinder->ignition_factor;
+	ignition_time[i] = cylinder->ignition_time;
+	intake_open_refl[i] = cylinder->intake_open_refl;
+	intake_closed_refl[i] = cylinder->intake_closed_refl;
+	exhaust_open_refl[i] = cylinder->exhaust_open_refl;
+	exhaust_closed_refl[i] = cylinder->exhaust_closed_refl;
+	intake_beta[i] = waveguides->beta[cylinder->intake_waveguide];
+	exhaust_beta[i] = waveguides->beta[cylinder->exhaust_waveguide];
+	extractor_alpha[i] = waveguides->alpha[cylinder->extractor_waveguide];
+	extractor_beta[i] = waveguides->beta[cylinder->extractor_waveguide];
+}
+
+void CylinderBank::process_block(
+	uint32_t frames, const uint32_t *crank_phase, const uint32_t *fluctuated_crank_phase,
+	const float *intake_noise, const float *intake_collector, const float *last_exhaust_collector,
+	uint32_t intake_valve_shift, uint32_t exhaust_valve_shift
+) {
+	const vfloat zero = v_set(0.0f);
+	const vfloat one = v_set(1.0f);
+	const vfloat half = v_set(0.5f);
+	const vint in_shift = vi_set(intake_valve_shift);
+	const vint ex_shift = vi_set(exhaust_valve_shift);
+	const vfloat num_cyl = v_set((float)count);
+
+	for (uint32_t c = 0; c < lanes; c += ENGINE_SIMD_LANES) {
+		vmask mask = v_gt(v_load(lane_mask + c), zero);
+
+		vint offset = vi_load(crank_offset + c);
+		vfloat motion_factor = v_load(piston_motion_factor + c);
+		vfloat ign_factor = v_load(ignition_factor + c);
+		vfloat ign_time = v_load(ignition_time + c);
+		vfloat in_open = v_load(intake_open_refl + c);
+		vfloat in_closed = v_load(intake_closed_refl + c);
+		vfloat ex_open = v_load(exhaust_open_refl + c);
+		vfloat ex_closed = v_load(exhaust_closed_refl + c);
+		vfloat in_beta = v_load(intake_beta + c);
+		vfloat ex_beta = v_load(exhaust_beta + c);
+		vfloat ext_alpha = v_load(extractor_alpha + c);
+		vfloat ext_beta = v_load(extractor_beta + c);
+
+		vfloat ex_c0_gain = v_sub(one, v_abs(ex_beta));
+		vfloat ext_c1_gain = v_sub(one, v_abs(ext_alpha));
+
+		vfloat ex_alpha = v_load(exhaust_alpha + c);
+		vfloat in_alpha = v_load(intake_alpha + c);
+
+		for (uint32_t j = 0; j < frames; j++) {
+			uint32_t k = j * lanes + c;
+
+			vint crank_i = vi_add(vi_set(fluctuated_crank_phase[j]), offset);
+			vfloat crank = v_phase_to_turns(crank_i);
+
+			vfloat sound = v_add(
+				v_mul(v_piston_motion(crank), motion_factor),
+				v_mul(v_fuel_ignition(crank, ign_time), ign_factor)
+			);
+			sound = v_mask(mask, sound);
+
+			vfloat ex_valve = v_exhaust_valve(v_phase_to_turns(vi_add(crank_i, ex_shift)));
+			vfloat in_valve = v_intake_valve(v_phase_to_turns(vi_add(crank_i, in_shift)));
+
+			ex_alpha = v_add(ex_closed, v_mul(v_sub(ex_open, ex_closed), ex_valve));
+			in_alpha = v_add(in_closed, v_mul(v_sub(in_open, in_closed), in_valve));
+
+			vfloat half_sound = v_mul(sound, half);
+
+			// Extractor
+			vfloat ext_c1_k = v_load(ext_c1 + k);
+			vfloat ext_c0_k = v_load(ext_c0 + k);
+			vfloat ex_c1_k = v_load(ex_c1 + k);
+			vfloat ex_c0_k = v_load(ex_c0 + k);
+
+			vfloat extractor_exhaust = v_mul(ext_c1_k, ext_c1_gain);
+			v_store(ext_in0 + k, v_add(v_mul(ext_c1_k, ext_alpha), v_mul(ex_c0_k, ex_c0_gain)));
+			v_store(ext_in1 + k, v_add(v_mul(ext_c0_k, ext_beta), v_set(last_exhaust_collector[j])));
+
+			// Exhaust
+			v_store(ex_in0 + k, v_add(v_mul(ex_c1_k, ex_alpha), v_mul(v_sub(one, v_abs(ex_alpha)), half_sound)));
+			v_store(ex_in1 + k, v_add(v_mul(ex_c0_k, ex_beta), extractor_exhaust));
+
+			// Intake
+			vfloat in_c1_k = v_load(in_c1 + k);
+			vfloat in_c0_k = v_load(in_c0 + k);
+
+			vfloat intake = v_add(
+				v_div(v_set(intake_collector[j]), num_cyl),
+				v_mul(v_set(intake_noise[j]), v_intake_valve(v_phase_to_turns(vi_add(vi_set(crank_phase[j]), offset))))
+			);
+
+			v_store(in_in0 + k, v_add(v_mul(in_c1_k, in_alpha), v_mul(v_sub(one, v_abs(in_alpha)), half_sound)));
+			v_store(in_in1 + k, v_add(v_mul(in_c0_k, in_beta), intake));
+
+			v_store(cyl_sound + k, sound);
+		}
+
+		v_store(exhaust_alpha + c, ex_alpha);
+		v_store(intake_alpha + c, in_alpha);
+	}
+}
+
+void CylinderBank::resize(uint32_t count) {
+	uint32_t new_lanes = align_count(count > 0 ? count : 1, ENGINE_SIMD_LANES);
+
+	if (data && new_lanes == lanes) {
+		this->count = count;
+	} else {
+		if (data) {
+			aligned_free(data);
+		}
+
+		// 15 per cylinder arrays and 13 frame major block buffers
+		data = (float *)aligned_malloc((15 + 13 * WAVEGUIDE_MAX_BLOCK) * new_lanes * sizeof(float));
+		this->count = count;
+		this->lanes = new_lanes;
+
+		float *ptr = data;
+		crank_offset = (uint32_t *)ptr;
+		ptr += new_lanes;
+
+		float **arrays[] = {
+			&piston_motion_factor, &ignition_factor, &ignition_time,
+			&intake_open_refl, &intake_closed_refl, &exhaust_open_refl, &exhaust_closed_refl,
+			&intake_beta, &exhaust_beta, &extractor_alpha, &extractor_beta, &lane_mask,
+			&intake_alpha, &exhaust_alpha
+		};
+		for (uint32_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+			*arrays[i] = ptr;
+			ptr += new_lanes;
+		}
+
+		float **buffers[] = {
+			&ex_c1, &ex_c0, &in_c1, &in_c0, &ext_c1, &ext_c0,
+			&ex_in0, &ex_in1, &in_in0, &in_in1, &ext_in0, &ext_in1, &cyl_sound
+		};
+		for (uint32_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+			*buffers[i] = ptr;
+			ptr += new_lanes * WAVEGUIDE_MAX_BLOCK;
+		}
+
+		for (uint32_t i = 0; i < (15 + 13 * WAVEGUIDE_MAX_BLOCK) * new_lanes; i++) {
+			data[i] = 0.0f;
+		}
+	}
+
+	for (uint32_t i = 0; i < lanes; i++) {
+		lane_mask[i] = i < count ? 1.0f : 0.0f;
+		if (i >= count) {
+			crank_offset[i] = 0;
+			piston_motion_factor[i] = 0.0f;
+			ignition_factor[i] = 0.0f;
+			ignition_time[i] = 1.0f;
+			intake_open_refl[i] = 0.0f;
+			intake_closed_refl[i] = 0.0f;
+			exhaust_open_refl[i] = 0.0f;
+			exhaust_closed_refl[i] = 0.0f;
+			intake_beta[i] = 0.0f;
+			exhaust_beta[i] = 0.0f;
+			extractor_alpha[i] = 0.0f;
+			extractor_beta[i] = 0.0f;
+		}
+	}
+}
+
+EngineMain::EngineMain() {
+	// this->intake_volume = 0.0;
+	// this->exhaust_volume = 0.0;
+	// this->vibrations_volume = 0.0;
+
+	this->cylinders = std::vector<EngineCylinder *>();
+	this->cylinder_lanes = nullptr;
+	this->waveguides = nullptr;
+
+	this->intake_noise = nullptr;
+	this->intake_noise_factor = 0.0;
+
+	this->intake_noise_lp = nullptr;
+	this->vibration_filter = nullptr;
+	this->muffler = nullptr;
+
+	this->intake_valve_shift = 0;
+	this->exhaust_valve_shift = 0;
+	this->crankshaft_fluctuation = 0.0;
+
+	this->crankshaft_fluctuation_lp = nullptr;
+	this->crankshaft_noise = nullptr;
+	this->intake_noise_seed = 0;
+	this->crankshaft_noise_seed = 0;
+
+	this->crankshaft_phase = 0;
+	this->noise_pos = 0.0;
+	this->exhaust_collector = 0.0;
+	this->intake_collector = 0.0;
+}
+
+EngineMain::~EngineMain() {
+	for (uint32_t i = 0; i < cylinders.size(); i++) {
+		delete this->cylinders[i];
+	}
+
+	if (this->cylinder_lanes) {
+		delete this->cylinder_lanes;
+	}
+
+	if (this->waveguides) {
+		delete this->waveguides;
+	}
+
+	if (this->intake_noise) {
+		delete this->intake_noise;
+	}
+
+	if (this->intake_noise_lp) {
+		delete this->intake_noise_lp;
+	}
+
+	if (this->vibration_filter) {
+		delete this->vibration_filter;
+	}
+
+	if (this->muffler) {
+		delete this->muffler;
+	}
+
+	if (this->crankshaft_fluctuation_lp) {
+		delete this->crankshaft_fluctuation_lp;
+	}
+
+	if (this->crankshaft_noise) {
+		delete this->crankshaft_noise;
+	}
+}
+
+EngineCylinder::EngineCylinder() {
+	this->crank_offset = 0;
+	this->exhaust_waveguide = 0;
+	this->intake_waveguide = 0;
+	this->extractor_waveguide = 0;
+
+	this->intake_open_refl = 0.0;
+	this->intake_closed_refl = 0.0;
+	this->exhaust_open_refl = 0.0;
+	this->exhaust_closed_refl = 0.0;
+	this->piston_motion_factor = 0.0;
+	this->ignition_factor = 0.0;
+	this->ignition_time = 0.0;
+	this->ignition_window_len = 0;
+	this->ignition_window_scale = 0.0;
+	this->cyl_sound = 0.0;
+	this->extractor_exhaust = 0.0;
+}
+
+EngineCylinder::~EngineCylinder() {
+	
+}
+
+EngineMuffler::EngineMuffler() {
+	this->straight_pipe = 0;
+	this->muffler_elements = std::vector<uint32_t>();
+}
+
+LowPassFilter::LowPassFilter() {
+	this->delay = 0.0;
+	this->alpha = 0.0;
+	this->last = 0.0;
+}
+
+LowPassFilter::LowPassFilter(float freq, uint32_t sample_rate) {
+	this->delay = 1.0f / freq;
+	this->alpha = ((float)ENGINE_PI * 2 * (1.0f / sample_rate) * freq) /
+		((float)ENGINE_PI * 2 * (1.0f / sample_rate) * freq + 1);
+	this->last = 0.0;
+}
+
+ControlRateFilter::ControlRateFilter(float freq, uint32_t sample_rate) {
+	this->decimation = 1;
+	this->gain = 1.0f;
+	this->from = 0.0f;
+	this->to = 0.0f;
+	this->slope = 0.0f;
+	this->step = 0;
+	modify(freq, sample_rate);
+}
+
+WaveGuideBank::WaveGuideBank() {
+	this->count = 0;
+	this->stride = 0;
+	this->data_len = 0;
+	this->min_delay = 0;
+	this->data = nullptr;
+	this->block_data = nullptr;
+
+	this->offset = nullptr;
+	this->capacity = nullptr;
+	this->pos = nullptr;
+	this->delay_int = nullptr;
+	this->delay_frac = nullptr;
+	this->alpha = nullptr;
+	this->beta = nullptr;
+	this->c1_out = nullptr;
+	this->c0_out = nullptr;
+}
+
+WaveGuideBank::~WaveGuideBank() {
+	if (this->data) {
+		aligned_free(this->data);
+	}
+	if (this->block_data) {
+		aligned_free(this->block_data);
+	}
+	if (this->offset) {
+		aligned_free(this->offset);
+	}
+}
+
+CylinderBank::CylinderBank() {
+	this->count = 0;
+	this->lanes = 0;
+	this->data = nullptr;
+
+	this->crank_offset = nullptr;
+	this->piston_motion_factor = nullptr;
+	this->ignition_factor = nullptr;
+	this->ignition_time = nullptr;
+	this->intake_open_refl = nullptr;
+	this->intake_closed_refl = nullptr;
+	this->exhaust_open_refl = nullptr;
+	this->exhaust_closed_refl = nullptr;
+	this->intake_beta = nullptr;
+	this->exhaust_beta = nullptr;
+	this->extractor_alpha = nullptr;
+	this->extractor_beta = nullptr;
+	this->lane_mask = nullptr;
+
+	this->intake_alpha = nullptr;
+	this->exhaust_alpha = nullptr;
+
+	this->ex_c1 = nullptr;
+	this->ex_c0 = nullptr;
+	this->in_c1 = nullptr;
+	this->in_c0 = nullptr;
+	this->ext_c1 = nullptr;
+	this->ext_c0 = nullptr;
+	this->ex_in0 = nullptr;
+	this->ex_in1 = nullptr;
+	this->in_in0 = nullptr;
+	this->in_in1 = nullptr;
+	this->ext_in0 = nullptr;
+	this->ext_in1 = nullptr;
+	this->cyl_sound = nullptr;
+}
+
+CylinderBank::~CylinderBank() {
+	if (this->data) {
+		aligned_free(this->data);
+	}
+}
+
+// The middle slot index carries a flag telling the reader it hasn't been read yet
+#define CONTROLS_UNREAD 4u
+
+void EngineControls::publish() {
+	slots[back] = state;
+	back = middle.exchange(back | CONTROLS_UNREAD, std::memory_order_acq_rel) & ~CONTROLS_UNREAD;
+}
+
+const EngineControlState &EngineControls::read() {
+	if (middle.load(std::memory_order_relaxed) & CONTROLS_UNREAD) {
+		front = middle.exchange(front, std::memory_order_acq_rel) & ~CONTROLS_UNREAD;
+	}
+	return slots[front];
+}
+
+EngineControlState::EngineControlState() {
+	this->rpm = 0.0;
+	this->volume = 0.0;
+	this->intake_volume = 0.0;
+	this->exhaust_volume = 0.0;
+	this->vibrations_volume = 0.0;
+}
+
+EngineControls::EngineControls() {
+	this->middle.store(1);
+	this->back = 0;
+	this->front = 2;
+}
+
+EngineCylinderParams::EngineCylinderParams() {
+	this->piston_motion_factor = 0.0;
+	this->ignition_factor = 0.0;
+	this->ignition_time = 0.0;
+	this->intake_pipe_length = 0.0;
+	this->exhaust_pipe_length = 0.0;
+	this->extractor_pipe_length = 0.0;
+	this->crank_offset = 0.0;
+}
+
+EngineParams::EngineParams() {
+	this->sample_rate = 0;
+	this->max_pipe_length = 0.0;
+
+	this->vibrations_filter_frequency = 0.0;
+	this->intake_noise_factor = 0.0;
+	this->intake_noise_filter_frequency = 0.0;
+	this->intake_valve_shift = 0.0;
+	this->exhaust_valve_shift = 0.0;
+	this->crankshaft_fluctuation = 0.0;
+	this->crankshaft_fluctuation_filter_frequency = 0.0;
+
+	this->intake_noise_seed = 0;
+	this->crankshaft_noise_seed = 0;
+
+	this->straight_pipe_extractor_side_refl = 0.0;
+	this->straight_pipe_muffler_side_refl = 0.0;
+	this->straight_pipe_length = 0.0;
+	this->output_side_refl = 0.0;
+	this->muffler_cavity_lengths = std::vector<float>();
+
+	this->cylinder_intake_opened_refl = 0.0;
+	this->cylinder_intake_closed_refl = 0.0;
+	this->cylinder_exhaust_opened_refl = 0.0;
+	this->cylinder_exhaust_closed_refl = 0.0;
+	this->cylinder_intake_open_end_refl = 0.0;
+	this->cylinder_extractor_open_end_refl = 0.0;
+	this->cylinders = std::vector<EngineCylinderParams>();
+}
+
+void EngineRebuilder::request(const EngineParams &params, uint32_t crank_phase, float inc, uint32_t preheat_frames) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending = params;
+		pending_crank_phase = crank_phase;
+		pending_inc = inc;
+		pending_preheat_frames = preheat_frames;
+		has_pending = true;
+
+		if (!thread.joinable()) {
+			thread = std::thread(&EngineRebuilder::run, this);
+		}
+	}
+	cond.notify_one();
+}
+
+EngineMain *EngineRebuilder::take() {
+	// The engine being replaced goes to the retired slot, so it has to be free
+	if (retired.load(std::memory_order_acquire)) {
+		return nullptr;
+	}
+	return built.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+void EngineRebuilder::retire(EngineMain *engine) {
+	// Stored under the lock so the worker can't check the slot and then miss the wakeup
+	std::lock_guard<std::mutex> lock(mutex);
+	retired.store(engine, std::memory_order_release);
+	cond.notify_one();
+}
+
+void EngineRebuilder::run() {
+	EngineParams params;
+	uint32_t crank_phase = 0;
+	float inc = 0.0f;
+	uint32_t preheat_frames = 0;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!quit) {
+		cond.wait(lock, [this] {
+			return quit || has_pending || retired.load(std::memory_order_acquire);
+		});
+
+		bool build = has_pending && !quit;
+		if (build) {
+			params = pending;
+			crank_phase = pending_crank_phase;
+			inc = pending_inc;
+			preheat_frames = pending_preheat_frames;
+			has_pending = false;
+		}
+		lock.unlock();
+
+		EngineMain *old_engine = retired.exchange(nullptr, std::memory_order_acq_rel);
+		if (old_engine) {
+			delete old_engine;
+		}
+
+		if (build) {
+			uint64_t start = engine_stats_now();
+			EngineMain *new_engine = new EngineMain();
+			new_engine->build(params);
+
+			// Filled delay lines, so the swap doesn't fade in a silent engine
+			new_engine->crankshaft_phase = crank_phase;
+			if (preheat) {
+				preheat(new_engine, preheat_frames, inc);
+			}
+			if (stats) {
+				stats->add_rebuild(engine_stats_now() - start);
+			}
+
+			// Replaced before the renderer picked it up
+			EngineMain *stale_engine = built.exchange(new_engine, std::memory_order_acq_rel);
+			if (stale_engine) {
+				delete stale_engine;
+			}
+		}
+
+		lock.lock();
+	}
+}
+
+EngineRebuilder::EngineRebuilder() {
+	this->quit = false;
+	this->has_pending = false;
+	this->pending_crank_phase = 0;
+	this->pending_inc = 0.0f;
+	this->pending_preheat_frames = 0;
+	this->stats = nullptr;
+	this->built.store(nullptr);
+	this->retired.store(nullptr);
+}
+
+EngineRebuilder::~EngineRebuilder() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	cond.notify_one();
+
+	if (thread.joinable()) {
+		thread.join();
+	}
+
+	EngineMain *engine = built.exchange(nullptr);
+	if (engine) {
+		delete engine;
+	}
+	engine = retired.exchange(nullptr);
+	if (engine) {
+		delete engine;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,435 @@
+#ifndef CAR_ENGINE_H
+#define CAR_ENGINE_H
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "rand_counter.h"
+#include "engine_stats.h"
+#include <stdio.h>
+#include <iostream>
+
+// Longest run of frames processed at once by the block renderer
+#define WAVEGUIDE_MAX_BLOCK 64
+
+// Low passed noise is computed once per this many frames at most, with at least this
+// many control values per period of its filter frequency
+#define NOISE_MAX_DECIMATION 16
+#define NOISE_CONTROL_OVERSAMPLING 32
+
+class EngineMain;
+class EngineCylinder;
+class EngineMuffler;
+class LowPassFilter;
+class ControlRateFilter;
+class WaveGuideBank;
+class CylinderBank;
+class EngineControls;
+class EngineParams;
+class DelayLine;
+
+class EngineMain {
+public:
+	// float intake_volume;
+	// float exhaust_volume;
+	// float vibrations_volume;
+
+	std::vector<EngineCylinder *> cylinders;
+	CylinderBank *cylinder_lanes;
+	WaveGuideBank *waveguides;
+	CounterNoise *intake_noise;
+	float intake_noise_factor;
+	ControlRateFilter *intake_noise_lp;
+	LowPassFilter *vibration_filter;
+	EngineMuffler *muffler;
+
+	uint32_t intake_valve_shift;
+	uint32_t exhaust_valve_shift;
+	float crankshaft_fluctuation;
+
+	ControlRateFilter *crankshaft_fluctuation_lp;
+	CounterNoise *crankshaft_noise;
+
+	// 0 when the noise was seeded randomly, otherwise clear() rewinds it to the start
+	uint32_t intake_noise_seed;
+	uint32_t crankshaft_noise_seed;
+
+	uint32_t crankshaft_phase;
+	float noise_pos;
+	float exhaust_collector;
+	float intake_collector;
+
+	// Reused by build so rebuilding the same layout doesn't allocate. waveguide_delays
+	// keeps the fractional delays the guides were built for.
+	std::vector<float> waveguide_delays;
+	std::vector<float> waveguide_max_delays;
+	std::vector<int32_t> waveguide_sources;
+
+	// Builds the engine from params, or updates it in place keeping the state of the
+	// cylinders and pipes that still exist
+	void build(const EngineParams &params);
+
+	void clear();
+
+	void debug_print();
+
+	EngineMain();
+	~EngineMain();
+};
+
+class EngineCylinder {
+public:
+	uint32_t crank_offset;
+	uint32_t exhaust_waveguide;
+	uint32_t intake_waveguide;
+	uint32_t extractor_waveguide;
+
+	float intake_open_refl;
+	float intake_closed_refl;
+	float exhaust_open_refl;
+	float exhaust_closed_refl;
+
+	float piston_motion_factor;
+	float ignition_factor;
+	float ignition_time;
+	uint32_t ignition_window_len;
+	float ignition_window_scale;
+
+	float cyl_sound;
+	float extractor_exhaust;
+
+	void pop(
+		WaveGuideBank *waveguides,
+		uint32_t crank_phase, float exhaust_collector, uint32_t intake_valve_shift, uint32_t exhaust_valve_shift, 
+		float &intake, float &exhaust, float &piston_ignition, bool &waveguide_dampened
+	);
+	void push(WaveGuideBank *waveguides, float intake);
+
+	void clear();
+
+	void debug_print(WaveGuideBank *waveguides, uint32_t indent);
+
+	EngineCylinder();
+	~EngineCylinder();
+};
+
+class EngineMuffler {
+public:
+	uint32_t straight_pipe;
+	std::vector<uint32_t> muffler_elements;
+
+	void debug_print(WaveGuideBank *waveguides, uint32_t indent);
+
+	EngineMuffler();
+	~EngineMuffler() {}
+};
+
+class LowPassFilter {
+public:
+	float delay;
+	float alpha;
+	float last;
+
+	float filter(float sample);
+
+	float get_frequency() const {return 1.f / delay;}
+
+	void modify(float freq, uint32_t sample_rate);
+
+	void clear();
+
+	LowPassFilter();
+	LowPassFilter(float freq, uint32_t sample_rate);
+	~LowPassFilter() {}
+};
+
+// Noise through a one pole low pass, filtered at a control rate and linearly interpolated
+// back to the sample rate. The decimation is picked from the filter frequency, filters
+// close to the audio band stay per sample and give the same output as LowPassFilter.
+class ControlRateFilter {
+public:
+	LowPassFilter filter;
+	uint32_t decimation;
+	float gain;
+
+	// The output ramps from the previous control value to the latest one
+	float from;
+	float to;
+	float slope;
+	uint32_t step;
+
+	void advance(CounterNoise *noise);
+	float next(CounterNoise *noise);
+	void fill(CounterNoise *noise, float *p_out, uint32_t p_count);
+
+	uint32_t get_decimation() const {return decimation;}
+
+	void modify(float freq, uint32_t sample_rate);
+
+	// Continues from where other is, when both run at the same control rate
+	void copy_state(const ControlRateFilter *other);
+
+	void clear();
+
+	ControlRateFilter(float freq, uint32_t sample_rate);
+	~ControlRateFilter() {}
+};
+
+// Every waveguide of an engine stored in a handful of cache line aligned arrays.
+// Guides are addressed by index, per guide state is laid out as structure of arrays
+// and the delay lines share a single buffer with both chambers of a guide interleaved
+// (frame n of a guide is data[offset + n * 2 + 0] for chamber 0 and + 1 for chamber 1).
+// Delay lines are allocated with a fixed capacity and read at a fractional delay
+// with linear interpolation, so the delay can change at runtime without reallocating.
+class WaveGuideBank {
+public:
+	uint32_t count;
+	uint32_t stride;
+	uint32_t data_len;
+	uint32_t min_delay;
+	float *data;
+	float *block_data;
+
+	uint32_t *offset;
+	uint32_t *capacity;
+	uint32_t *pos;
+	uint32_t *delay_int;
+	float *delay_frac;
+	float *alpha;
+	float *beta;
+	float *c1_out;
+	float *c0_out;
+
+	void pop(uint32_t guide, float &c1, float &c0, bool &dampened);
+	void push(uint32_t guide, float x0_in, float x1_in);
+
+	void set_reflection(uint32_t guide, float alpha, float beta);
+
+	// Delay in samples between a push and the pop that returns it, at least one and
+	// at most get_max_delay(guide). Only touches coefficients, call update_min_delay()
+	// once after a batch of set_delay calls and before the next block.
+	void set_delay(uint32_t guide, float delay);
+	void update_min_delay();
+	float get_delay(uint32_t guide) const {return (float)delay_int[guide] + delay_frac[guide];}
+	float get_max_delay(uint32_t guide) const {return (float)(capacity[guide] - 1);}
+
+	// Block processing. A guide's output can't depend on its own input before the whole
+	// delay line has been traversed, so up to get_max_block() frames can be read at once,
+	// processed and written back. read_block fills the dampened chamber outputs (before
+	// reflection scaling) of the next frames, write_block stores the chamber inputs.
+	// The pointer versions read into and write from strided buffers.
+	uint32_t get_max_block() const;
+	float *get_block_c1(uint32_t guide) {return block_data + guide * WAVEGUIDE_MAX_BLOCK * 4;}
+	float *get_block_c0(uint32_t guide) {return get_block_c1(guide) + WAVEGUIDE_MAX_BLOCK;}
+	float *get_block_in0(uint32_t guide) {return get_block_c1(guide) + WAVEGUIDE_MAX_BLOCK * 2;}
+	float *get_block_in1(uint32_t guide) {return get_block_c1(guide) + WAVEGUIDE_MAX_BLOCK * 3;}
+
+	void read_block(uint32_t guide, uint32_t frames, bool &dampened);
+	void read_block(uint32_t guide, uint32_t frames, float *c1, float *c0, uint32_t stride, bool &dampened);
+	void write_block(uint32_t guide, uint32_t frames);
+	void write_block(uint32_t guide, uint32_t frames, const float *in0, const float *in1, uint32_t stride);
+
+	// Lays out count guides with room for the given delays. sources[i] is the index the
+	// guide had in the previous layout (or -1 for a new guide), its most recent samples,
+	// delay and outputs are carried over. Nothing is allocated when the layout is unchanged.
+	void modify(uint32_t count, const float *max_delays, const int32_t *sources);
+
+	void clear();
+
+	void debug_print(uint32_t guide, uint32_t indent);
+
+	WaveGuideBank();
+	~WaveGuideBank();
+};
+
+// Cylinder parameters laid out one lane per cylinder, padded to a multiple of
+// ENGINE_SIMD_LANES, so the block renderer can process several cylinders per instruction.
+// Block buffers are frame major: frame j of cylinder i is at [j * lanes + i].
+// Padding lanes have every factor at zero and are masked out of the outputs.
+class CylinderBank {
+public:
+	uint32_t count;
+	uint32_t lanes;
+	float *data;
+
+	uint32_t *crank_offset;
+	float *piston_motion_factor;
+	float *ignition_factor;
+	float *ignition_time;
+	float *intake_open_refl;
+	float *intake_closed_refl;
+	float *exhaust_open_refl;
+	float *exhaust_closed_refl;
+	float *intake_beta;
+	float *exhaust_beta;
+	float *extractor_alpha;
+	float *extractor_beta;
+	float *lane_mask;
+
+	float *intake_alpha;
+	float *exhaust_alpha;
+
+	float *ex_c1;
+	float *ex_c0;
+	float *in_c1;
+	float *in_c0;
+	float *ext_c1;
+	float *ext_c0;
+	float *ex_in0;
+	float *ex_in1;
+	float *in_in0;
+	float *in_in1;
+	float *ext_in0;
+	float *ext_in1;
+	float *cyl_sound;
+
+	void set_cylinder(uint32_t i, EngineCylinder *cylinder, WaveGuideBank *waveguides);
+
+	// Runs pop and push of every cylinder over a block, reading the *_c1/*_c0 buffers
+	// and writing the *_in0/*_in1 chamber inputs and cyl_sound
+	void process_block(
+		uint32_t frames, const uint32_t *crank_phase, const uint32_t *fluctuated_crank_phase,
+		const float *intake_noise, const float *intake_collector, const float *last_exhaust_collector,
+		uint32_t intake_valve_shift, uint32_t exhaust_valve_shift
+	);
+
+	void resize(uint32_t count);
+
+	CylinderBank();
+	~CylinderBank();
+};
+
+// Parameters that change while the engine is playing
+class EngineControlState {
+public:
+	float rpm;
+	float volume;
+	float intake_volume;
+	float exhaust_volume;
+	float vibrations_volume;
+
+	EngineControlState();
+	~EngineControlState() {}
+};
+
+// Hands EngineControlState from a control thread to the renderer through a triple buffer.
+// The writer edits state and publishes a whole copy, the renderer picks up the latest
+// published copy with read() once per block. Both sides are wait free and never see a
+// half written state, as long as there is a single writer and a single reader.
+class EngineControls {
+public:
+	EngineControlState state;
+
+	EngineControlState slots[3];
+	std::atomic<uint32_t> middle;
+	uint32_t back;
+	uint32_t front;
+
+	void publish();
+	const EngineControlState &read();
+
+	void set_rpm(float p_rpm) {state.rpm = p_rpm; publish();}
+	void set_volume(float p_volume) {state.volume = p_volume; publish();}
+	void set_intake_volume(float p_volume) {state.intake_volume = p_volume; publish();}
+	void set_exhaust_volume(float p_volume) {state.exhaust_volume = p_volume; publish();}
+	void set_vibrations_volume(float p_volume) {state.vibrations_volume = p_volume; publish();}
+
+	EngineControls();
+	~EngineControls() {}
+};
+
+class EngineCylinderParams {
+public:
+	float piston_motion_factor;
+	float ignition_factor;
+	float ignition_time;
+	float intake_pipe_length;
+	float exhaust_pipe_length;
+	float extractor_pipe_length;
+	float crank_offset;
+
+	EngineCylinderParams();
+	~EngineCylinderParams() {}
+};
+
+// Everything EngineMain::build needs, copied out of the config resources so an
+// engine can be built away from the thread that edits them
+class EngineParams {
+public:
+	uint32_t sample_rate;
+	float max_pipe_length;
+
+	float vibrations_filter_frequency;
+	float intake_noise_factor;
+	float intake_noise_filter_frequency;
+	float intake_valve_shift;
+	float exhaust_valve_shift;
+	float crankshaft_fluctuation;
+	float crankshaft_fluctuation_filter_frequency;
+
+	// Fixed noise seeds make renders repeatable, 0 seeds from the clock
+	uint32_t intake_noise_seed;
+	uint32_t crankshaft_noise_seed;
+
+	float straight_pipe_extractor_side_refl;
+	float straight_pipe_muffler_side_refl;
+	float straight_pipe_length;
+	float output_side_refl;
+	std::vector<float> muffler_cavity_lengths;
+
+	float cylinder_intake_opened_refl;
+	float cylinder_intake_closed_refl;
+	float cylinder_exhaust_opened_refl;
+	float cylinder_exhaust_closed_refl;
+	float cylinder_intake_open_end_refl;
+	float cylinder_extractor_open_end_refl;
+	std::vector<EngineCylinderParams> cylinders;
+
+	EngineParams();
+	~EngineParams() {}
+};
+
+// Builds engines on a worker thread. request() hands over a parameter snapshot (the
+// newest one wins), take() returns the latest finished engine, and retire() gives an
+// engine back to the worker to be deleted, so the renderer never allocates or frees one.
+// take() is wait free and retire() only holds the lock to wake the worker, both are
+// meant to be called from the render thread.
+class EngineRebuilder {
+public:
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool quit;
+
+	EngineParams pending;
+	bool has_pending;
+
+	// Where the renderer was at the request, a built engine starts at that crank phase
+	// and is preheated for preheat_frames at the same speed before it is published
+	uint32_t pending_crank_phase;
+	float pending_inc;
+	uint32_t pending_preheat_frames;
+
+	// Renders an engine on the worker, set by the owner before the first request
+	std::function<void(EngineMain *, uint32_t, float)> preheat;
+
+	std::atomic<EngineMain *> built;
+	std::atomic<EngineMain *> retired;
+
+	// Build times go to the owner's counters, may be null
+	EngineStats *stats;
+
+	void request(const EngineParams &params, uint32_t crank_phase, float inc, uint32_t preheat_frames);
+	EngineMain *take();
+	void retire(EngineMain *engine);
+
+	void run();
+
+	EngineRebuilder();
+	~EngineRebuilder();
+};
+
+#endif // CAR_ENGINE_H
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "engine_resampler.h"
+#include <cstring>
+
+// Modified Bessel function of the first kind, order 0
+static inline double bessel_i0(double x) {
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 32; k++) {
+		double f = x / (2.0 * k);
+		term *= f * f;
+		sum += term;
+		if (term < sum * 1e-12) break;
+	}
+	return sum;
+}
+
+void EngineResampler::configure(uint32_t p_input_rate, uint32_t p_output_rate, int p_quality, uint32_t p_max_push) {
+	// Taps, Kaiser beta and cutoff relative to the lower Nyquist frequency
+	static const uint32_t quality_taps[] = {8, 16, 32};
+	static const double quality_beta[] = {4.0, 6.0, 8.0};
+	static const double quality_rolloff[] = {0.80, 0.88, 0.92};
+
+	quality = p_quality < RESAMPLER_QUALITY_LOW ? RESAMPLER_QUALITY_LOW : (p_quality > RESAMPLER_QUALITY_HIGH ? RESAMPLER_QUALITY_HIGH : p_quality);
+	input_rate = p_input_rate;
+	output_rate = p_output_rate;
+	taps = align_count(quality_taps[quality], ENGINE_SIMD_LANES);
+
+	// Cutoff in cycles per input frame, downsampling also has to stay below the output Nyquist
+	double ratio = (double)output_rate / (double)input_rate;
+	double cutoff = 0.5 * (ratio < 1.0 ? ratio : 1.0) * quality_rolloff[quality];
+	double beta = quality_beta[quality];
+	double half = taps * 0.5;
+	double i0_beta = bessel_i0(beta);
+
+	if (coeffs) aligned_free(coeffs);
+	coeffs = (float *)aligned_malloc(sizeof(float) * taps * (ENGINE_RESAMPLER_PHASES + 1));
+
+	for (uint32_t p = 0; p <= ENGINE_RESAMPLER_PHASES; p++) {
+		float *row = coeffs + p * taps;
+		double phase = p / (double)ENGINE_RESAMPLER_PHASES;
+		double sum = 0.0;
+
+		for (uint32_t k = 0; k < taps; k++) {
+			// Distance from the output position, which sits half - 1 + phase into the window
+			double t = (double)k - (half - 1.0) - phase;
+			double x = 2.0 * cutoff * t;
+			double sinc = x == 0.0 ? 1.0 : std::sin(ENGINE_PI * x) / (ENGINE_PI * x);
+			double w = t / half;
+			double window = w * w < 1.0 ? bessel_i0(beta * std::sqrt(1.0 - w * w)) / i0_beta : 0.0;
+
+			row[k] = (float)(sinc * window);
+			sum += row[k];
+		}
+
+		// Unity gain at DC for every phase
+		for (uint32_t k = 0; k < taps; k++) {
+			row[k] = (float)(row[k] / sum);
+		}
+	}
+
+	if (input) aligned_free(input);
+	capacity = taps + p_max_push;
+	input = (float *)aligned_malloc(sizeof(float) * capacity);
+
+	step = ((uint64_t)input_rate << 32) / output_rate;
+
+	clear();
+}
+
+void EngineResampler::clear() {
+	if (!input) return;
+
+	// The first output lands on the first pushed frame
+	memset(input, 0, sizeof(float) * capacity);
+	count = taps / 2 - 1;
+	read = 0;
+	frac = 0;
+}
+
+void EngineResampler::push(const float *p_frames, uint32_t p_count) {
+	p_count = p_count < capacity - count ? p_count : capacity - count;
+
+	memcpy(input + count, p_frames, sizeof(float) * p_count);
+	count += p_count;
+}
+
+uint32_t EngineResampler::pop(float *p_out, uint32_t p_max_frames, int p_channels) {
+	uint32_t frames = 0;
+
+	while (frames < p_max_frames && read + taps <= count) {
+		const float *c0 = coeffs + (frac >> (32 - ENGINE_RESAMPLER_PHASE_BITS)) * taps;
+		const float *c1 = c0 + taps;
+		const float *x = input + read;
+		vfloat t = v_set((frac << ENGINE_RESAMPLER_PHASE_BITS) * (1.0f / 4294967296.0f));
+		vfloat sum = v_set(0.0f);
+
+		for (uint32_t k = 0; k < taps; k += ENGINE_SIMD_LANES) {
+			vfloat a = v_load(c0 + k);
+			vfloat c = v_add(a, v_mul(v_sub(v_load(c1 + k), a), t));
+			sum = v_add(sum, v_mul(c, v_loadu(x + k)));
+		}
+
+		float y = v_hsum(sum);
+		for (int c = 0; c < p_channels; c++) {
+			p_out[frames * p_channels + c] = y;
+		}
+		frames++;
+
+		uint64_t pos = (uint64_t)frac + step;
+		read += (uint32_t)(pos >> 32);
+		frac = (uint32_t)pos;
+	}
+
+	// Drop the frames the window moved past
+	uint32_t consumed = read < count ? read : count;
+	if (consumed > 0) {
+		memmove(input, input + consumed, sizeof(float) * (count - consumed));
+		count -= consumed;
+		read -= consumed;
+	}
+
+	return frames;
+}
+
+EngineResampler::EngineResampler() {
+	this->input_rate = 0;
+	this->output_rate = 0;
+	this->quality = RESAMPLER_QUALITY_MEDIUM;
+	this->taps = 0;
+	this->coeffs = nullptr;
+	this->input = nullptr;
+	this->capacity = 0;
+	this->count = 0;
+	this->read = 0;
+	this->step = 0;
+	this->frac = 0;
+}
+
+EngineResampler::~EngineResampler() {
+	if (coeffs) aligned_free(coeffs);
+	if (input) aligned_free(input);
+}
\ No newline at end of file
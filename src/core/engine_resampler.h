@@ -0,0 +1,58 @@
+#ifndef ENGINE_RESAMPLER_H
+#define ENGINE_RESAMPLER_H
+
+#include <cstdint>
+#include "engine_utils.h"
+
+// Kaiser windowed sinc tabulated at ENGINE_RESAMPLER_PHASES positions between two
+// input frames, outputs interpolate linearly between the two closest ones. This
+// handles any pair of rates with a single table.
+#define ENGINE_RESAMPLER_PHASE_BITS 8
+#define ENGINE_RESAMPLER_PHASES (1 << ENGINE_RESAMPLER_PHASE_BITS)
+
+enum {
+	RESAMPLER_QUALITY_LOW = 0,
+	RESAMPLER_QUALITY_MEDIUM = 1,
+	RESAMPLER_QUALITY_HIGH = 2,
+};
+
+class EngineResampler {
+public:
+	uint32_t input_rate;
+	uint32_t output_rate;
+	int quality;
+	uint32_t taps;
+
+	// ENGINE_RESAMPLER_PHASES + 1 rows of taps, aligned for the vector loads
+	float *coeffs;
+
+	// Pushed frames not consumed yet, the filter window starts at read
+	float *input;
+	uint32_t capacity;
+	uint32_t count;
+	uint32_t read;
+
+	// Input frames per output frame and the position between two input frames,
+	// both 32.32 fixed point
+	uint64_t step;
+	uint32_t frac;
+
+	bool is_configured(uint32_t p_input_rate, uint32_t p_output_rate, int p_quality) const {
+		return coeffs && input_rate == p_input_rate && output_rate == p_output_rate && quality == p_quality;
+	}
+
+	// p_max_push is the most frames a single push may bring
+	void configure(uint32_t p_input_rate, uint32_t p_output_rate, int p_quality, uint32_t p_max_push);
+	void clear();
+
+	// Only call with pop unable to produce more, that keeps the frames left below taps
+	void push(const float *p_frames, uint32_t p_count);
+
+	// Writes up to p_max_frames frames to every channel, returns how many it wrote
+	uint32_t pop(float *p_out, uint32_t p_max_frames, int p_channels);
+
+	EngineResampler();
+	~EngineResampler();
+};
+
+#endif // ENGINE_RESAMPLER_H
\ No newline at end of file
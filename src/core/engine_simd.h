@@ -0,0 +1,198 @@
+#ifndef ENGINE_SIMD_H
+#define ENGINE_SIMD_H
+
+#include <cstdint>
+#include <cmath>
+
+// Thin wrapper over the vector instructions used by the cylinder kernel.
+// AVX2 is used when the compiler targets it (8 lanes), SSE2 otherwise (4 lanes),
+// with a scalar fallback for targets without either.
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ENGINE_SIMD_LANES 8
+
+typedef __m256 vfloat;
+typedef __m256 vmask;
+typedef __m256i vint;
+
+inline vfloat v_load(const float *p) {return _mm256_load_ps(p);}
+inline vfloat v_loadu(const float *p) {return _mm256_loadu_ps(p);}
+inline void v_store(float *p, vfloat a) {_mm256_store_ps(p, a);}
+inline vfloat v_set(float a) {return _mm256_set1_ps(a);}
+inline vfloat v_add(vfloat a, vfloat b) {return _mm256_add_ps(a, b);}
+inline vfloat v_sub(vfloat a, vfloat b) {return _mm256_sub_ps(a, b);}
+inline vfloat v_mul(vfloat a, vfloat b) {return _mm256_mul_ps(a, b);}
+inline vfloat v_div(vfloat a, vfloat b) {return _mm256_div_ps(a, b);}
+inline vfloat v_abs(vfloat a) {return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a);}
+inline vfloat v_round(vfloat a) {return _mm256_cvtepi32_ps(_mm256_cvtps_epi32(a));}
+inline vmask v_lt(vfloat a, vfloat b) {return _mm256_cmp_ps(a, b, _CMP_LT_OQ);}
+inline vmask v_gt(vfloat a, vfloat b) {return _mm256_cmp_ps(a, b, _CMP_GT_OQ);}
+inline vmask v_and(vmask a, vmask b) {return _mm256_and_ps(a, b);}
+inline vfloat v_select(vmask m, vfloat a, vfloat b) {return _mm256_blendv_ps(b, a, m);}
+inline vfloat v_mask(vmask m, vfloat a) {return _mm256_and_ps(m, a);}
+inline float v_hsum(vfloat a) {
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+
+inline vint vi_load(const uint32_t *p) {return _mm256_load_si256((const __m256i *)p);}
+inline vint vi_set(uint32_t a) {return _mm256_set1_epi32((int)a);}
+inline vint vi_add(vint a, vint b) {return _mm256_add_epi32(a, b);}
+inline vint vi_mul(vint a, vint b) {return _mm256_mullo_epi32(a, b);}
+inline vint vi_xor(vint a, vint b) {return _mm256_xor_si256(a, b);}
+inline vint vi_shr(vint a, int n) {return _mm256_srli_epi32(a, n);}
+inline vint vi_lane_index() {return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);}
+inline void v_storeu(float *p, vfloat a) {_mm256_storeu_ps(p, a);}
+inline vfloat v_phase_to_turns(vint a) {
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(a, 8)), _mm256_set1_ps(1.0f / 16777216.0f));
+}
+// Top 24 bits as a signed fraction in [-1, 1), exact so every width gives the same floats
+inline vfloat v_bits_to_signed(vint a) {
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(a, 8)), _mm256_set1_ps(1.0f / 8388608.0f));
+}
+
+// 16 bit PCM to float in [-1, 1), count is a multiple of 8
+inline void v_pcm16_to_float(const int16_t *p_in, float *p_out, uint32_t count) {
+	const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+	for (uint32_t i = 0; i < count; i += 8) {
+		__m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(p_in + i)));
+		_mm256_storeu_ps(p_out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+	}
+}
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ENGINE_SIMD_LANES 4
+
+typedef __m128 vfloat;
+typedef __m128 vmask;
+typedef __m128i vint;
+
+inline vfloat v_load(const float *p) {return _mm_load_ps(p);}
+inline vfloat v_loadu(const float *p) {return _mm_loadu_ps(p);}
+inline void v_store(float *p, vfloat a) {_mm_store_ps(p, a);}
+inline vfloat v_set(float a) {return _mm_set1_ps(a);}
+inline vfloat v_add(vfloat a, vfloat b) {return _mm_add_ps(a, b);}
+inline vfloat v_sub(vfloat a, vfloat b) {return _mm_sub_ps(a, b);}
+inline vfloat v_mul(vfloat a, vfloat b) {return _mm_mul_ps(a, b);}
+inline vfloat v_div(vfloat a, vfloat b) {return _mm_div_ps(a, b);}
+inline vfloat v_abs(vfloat a) {return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);}
+inline vfloat v_round(vfloat a) {return _mm_cvtepi32_ps(_mm_cvtps_epi32(a));}
+inline vmask v_lt(vfloat a, vfloat b) {return _mm_cmplt_ps(a, b);}
+inline vmask v_gt(vfloat a, vfloat b) {return _mm_cmpgt_ps(a, b);}
+inline vmask v_and(vmask a, vmask b) {return _mm_and_ps(a, b);}
+inline vfloat v_select(vmask m, vfloat a, vfloat b) {return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));}
+inline vfloat v_mask(vmask m, vfloat a) {return _mm_and_ps(m, a);}
+inline float v_hsum(vfloat a) {
+	__m128 s = _mm_add_ps(a, _mm_movehl_ps(a, a));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+
+inline vint vi_load(const uint32_t *p) {return _mm_load_si128((const __m128i *)p);}
+inline vint vi_set(uint32_t a) {return _mm_set1_epi32((int)a);}
+inline vint vi_add(vint a, vint b) {return _mm_add_epi32(a, b);}
+// SSE2 only multiplies the even lanes to 64 bits, the odd ones go through a shift
+inline vint vi_mul(vint a, vint b) {
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(
+		_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+		_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0))
+	);
+}
+inline vint vi_xor(vint a, vint b) {return _mm_xor_si128(a, b);}
+inline vint vi_shr(vint a, int n) {return _mm_srli_epi32(a, n);}
+inline vint vi_lane_index() {return _mm_setr_epi32(0, 1, 2, 3);}
+inline void v_storeu(float *p, vfloat a) {_mm_storeu_ps(p, a);}
+inline vfloat v_phase_to_turns(vint a) {
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(a, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+}
+inline vfloat v_bits_to_signed(vint a) {
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(a, 8)), _mm_set1_ps(1.0f / 8388608.0f));
+}
+
+// 16 bit PCM to float in [-1, 1), count is a multiple of 8
+inline void v_pcm16_to_float(const int16_t *p_in, float *p_out, uint32_t count) {
+	const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+	for (uint32_t i = 0; i < count; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(p_in + i));
+		// Sign extend by placing each value in the high half and shifting back down
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		_mm_storeu_ps(p_out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(p_out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+}
+
+#else
+#define ENGINE_SIMD_LANES 1
+
+typedef float vfloat;
+typedef bool vmask;
+typedef uint32_t vint;
+
+inline vfloat v_load(const float *p) {return *p;}
+inline vfloat v_loadu(const float *p) {return *p;}
+inline void v_store(float *p, vfloat a) {*p = a;}
+inline vfloat v_set(float a) {return a;}
+inline vfloat v_add(vfloat a, vfloat b) {return a + b;}
+inline vfloat v_sub(vfloat a, vfloat b) {return a - b;}
+inline vfloat v_mul(vfloat a, vfloat b) {return a * b;}
+inline vfloat v_div(vfloat a, vfloat b) {return a / b;}
+inline vfloat v_abs(vfloat a) {return std::fabs(a);}
+inline vfloat v_round(vfloat a) {return std::nearbyint(a);}
+inline vmask v_lt(vfloat a, vfloat b) {return a < b;}
+inline vmask v_gt(vfloat a, vfloat b) {return a > b;}
+inline vmask v_and(vmask a, vmask b) {return a && b;}
+inline vfloat v_select(vmask m, vfloat a, vfloat b) {return m ? a : b;}
+inline vfloat v_mask(vmask m, vfloat a) {return m ? a : 0.0f;}
+inline float v_hsum(vfloat a) {return a;}
+
+inline vint vi_load(const uint32_t *p) {return *p;}
+inline vint vi_set(uint32_t a) {return a;}
+inline vint vi_add(vint a, vint b) {return a + b;}
+inline vint vi_mul(vint a, vint b) {return a * b;}
+inline vint vi_xor(vint a, vint b) {return a ^ b;}
+inline vint vi_shr(vint a, int n) {return a >> n;}
+inline vint vi_lane_index() {return 0;}
+inline void v_storeu(float *p, vfloat a) {*p = a;}
+inline vfloat v_phase_to_turns(vint a) {return (float)(a >> 8) * (1.0f / 16777216.0f);}
+inline vfloat v_bits_to_signed(vint a) {return (float)((int32_t)a >> 8) * (1.0f / 8388608.0f);}
+
+inline void v_pcm16_to_float(const int16_t *p_in, float *p_out, uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		p_out[i] = (float)p_in[i] * (1.0f / 32768.0f);
+	}
+}
+
+#endif
+
+// sin(2 * pi * turns), folded into a quarter turn and evaluated with a degree 11
+// polynomial (absolute error below 1e-7)
+inline vfloat v_sin_turns(vfloat turns) {
+	vfloat r = v_sub(turns, v_round(turns));
+	r = v_select(v_gt(r, v_set(0.25f)), v_sub(v_set(0.5f), r), r);
+	r = v_select(v_lt(r, v_set(-0.25f)), v_sub(v_set(-0.5f), r), r);
+
+	vfloat x = v_mul(r, v_set(6.28318530717958647692f));
+	vfloat x2 = v_mul(x, x);
+
+	vfloat p = v_set(-2.5052108385441718775e-8f);
+	p = v_add(v_mul(p, x2), v_set(2.7557319223985890653e-6f));
+	p = v_add(v_mul(p, x2), v_set(-1.9841269841269841270e-4f));
+	p = v_add(v_mul(p, x2), v_set(8.3333333333333333333e-3f));
+	p = v_add(v_mul(p, x2), v_set(-1.6666666666666666667e-1f));
+	p = v_add(v_mul(p, x2), v_set(1.0f));
+
+	return v_mul(p, x);
+}
+
+inline vfloat v_cos_turns(vfloat turns) {
+	return v_sin_turns(v_add(turns, v_set(0.25f)));
+}
+
+#endif // ENGINE_SIMD_H
\ No newline at end of file
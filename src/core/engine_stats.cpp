@@ -0,0 +1,94 @@
+#include "engine_stats.h"
+
+void EngineStats::store_max(std::atomic<uint64_t> &p_max, uint64_t p_value) {
+	uint64_t current = p_max.load(std::memory_order_relaxed);
+	while (p_value > current && !p_max.compare_exchange_weak(current, p_value, std::memory_order_relaxed)) {
+	}
+}
+
+void EngineStats::add_block(uint64_t p_ns, uint32_t p_frames, uint32_t p_sample_rate, bool p_dampened) {
+	blocks.fetch_add(1, std::memory_order_relaxed);
+	frames.fetch_add(p_frames, std::memory_order_relaxed);
+	busy_ns.fetch_add(p_ns, std::memory_order_relaxed);
+	store_max(max_block_ns, p_ns);
+
+	if (p_sample_rate > 0) {
+		audio_ns.fetch_add((uint64_t)p_frames * 1000000000ull / p_sample_rate, std::memory_order_relaxed);
+	}
+	if (p_dampened) {
+		dampened_blocks.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (total) {
+		total->add_block(p_ns, p_frames, p_sample_rate, p_dampened);
+	}
+}
+
+void EngineStats::add_rebuild(uint64_t p_ns) {
+	rebuilds.fetch_add(1, std::memory_order_relaxed);
+	rebuild_ns.fetch_add(p_ns, std::memory_order_relaxed);
+	store_max(max_rebuild_ns, p_ns);
+
+	if (total) {
+		total->add_rebuild(p_ns);
+	}
+}
+
+// Only clears this instance, the totals keep counting
+void EngineStats::reset() {
+	blocks.store(0, std::memory_order_relaxed);
+	frames.store(0, std::memory_order_relaxed);
+	busy_ns.store(0, std::memory_order_relaxed);
+	max_block_ns.store(0, std::memory_order_relaxed);
+	audio_ns.store(0, std::memory_order_relaxed);
+	dampened_blocks.store(0, std::memory_order_relaxed);
+	rebuilds.store(0, std::memory_order_relaxed);
+	rebuild_ns.store(0, std::memory_order_relaxed);
+	max_rebuild_ns.store(0, std::memory_order_relaxed);
+	reset_time.store(engine_stats_now(), std::memory_order_relaxed);
+}
+
+EngineStatsSnapshot EngineStats::get_snapshot() const {
+	EngineStatsSnapshot snapshot;
+
+	snapshot.blocks = blocks.load(std::memory_order_relaxed);
+	snapshot.frames = frames.load(std::memory_order_relaxed);
+	snapshot.busy_ns = busy_ns.load(std::memory_order_relaxed);
+	snapshot.max_block_ns = max_block_ns.load(std::memory_order_relaxed);
+	snapshot.audio_ns = audio_ns.load(std::memory_order_relaxed);
+	snapshot.dampened_blocks = dampened_blocks.load(std::memory_order_relaxed);
+	snapshot.rebuilds = rebuilds.load(std::memory_order_relaxed);
+	snapshot.rebuild_ns = rebuild_ns.load(std::memory_order_relaxed);
+	snapshot.max_rebuild_ns = max_rebuild_ns.load(std::memory_order_relaxed);
+	snapshot.elapsed_ns = engine_stats_now() - reset_time.load(std::memory_order_relaxed);
+
+	return snapshot;
+}
+
+EngineStats *EngineStats::get_total(EngineStatsKind p_kind) {
+	static EngineStats totals[ENGINE_STATS_KIND_COUNT];
+	return &totals[p_kind];
+}
+
+EngineStatsSnapshot::EngineStatsSnapshot() {
+	this->blocks = 0;
+	this->frames = 0;
+	this->busy_ns = 0;
+	this->max_block_ns = 0;
+	this->audio_ns = 0;
+	this->dampened_blocks = 0;
+	this->rebuilds = 0;
+	this->rebuild_ns = 0;
+	this->max_rebuild_ns = 0;
+	this->elapsed_ns = 0;
+}
+
+EngineStats::EngineStats(EngineStatsKind p_kind) {
+	this->total = get_total(p_kind);
+	reset();
+}
+
+EngineStats::EngineStats() {
+	this->total = nullptr;
+	reset();
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef ENGINE_STATS_H
+#define ENGINE_STATS_H
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+
+enum EngineStatsKind {
+	ENGINE_STATS_CONFIG,
+	ENGINE_STATS_GENERATOR,
+	ENGINE_STATS_PLAYER,
+	ENGINE_STATS_KIND_COUNT,
+};
+
+inline uint64_t engine_stats_now() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()
+	).count();
+}
+
+// Counters read at one point in time, with the derived figures the monitors show
+class EngineStatsSnapshot {
+public:
+	uint64_t blocks;
+	uint64_t frames;
+	uint64_t busy_ns;
+	uint64_t max_block_ns;
+	uint64_t audio_ns;
+	uint64_t dampened_blocks;
+	uint64_t rebuilds;
+	uint64_t rebuild_ns;
+	uint64_t max_rebuild_ns;
+	uint64_t elapsed_ns;
+
+	double get_average_block_usec() const {return blocks ? busy_ns / (1000.0 * blocks) : 0.0;}
+	double get_max_block_usec() const {return max_block_ns / 1000.0;}
+	// Seconds of audio rendered per second spent rendering
+	double get_realtime_factor() const {return busy_ns ? (double)audio_ns / busy_ns : 0.0;}
+	// Share of a core the rendering takes while playing in real time
+	double get_load() const {return audio_ns ? (double)busy_ns / audio_ns : 0.0;}
+	double get_frames_per_second() const {return elapsed_ns ? frames * 1e9 / elapsed_ns : 0.0;}
+	double get_average_rebuild_msec() const {return rebuilds ? rebuild_ns / (1e6 * rebuilds) : 0.0;}
+	double get_max_rebuild_msec() const {return max_rebuild_ns / 1e6;}
+
+	EngineStatsSnapshot();
+	~EngineStatsSnapshot() {}
+};
+
+// Render timing of one renderer, updated by the thread that renders and readable from
+// any other. Relaxed atomics, a block costs a clock read and a few adds. Every update
+// also goes into the process wide total of the same kind.
+class EngineStats {
+private:
+	std::atomic<uint64_t> blocks;
+	std::atomic<uint64_t> frames;
+	std::atomic<uint64_t> busy_ns;
+	std::atomic<uint64_t> max_block_ns;
+	std::atomic<uint64_t> audio_ns;
+	std::atomic<uint64_t> dampened_blocks;
+	std::atomic<uint64_t> rebuilds;
+	std::atomic<uint64_t> rebuild_ns;
+	std::atomic<uint64_t> max_rebuild_ns;
+	std::atomic<uint64_t> reset_time;
+
+	EngineStats *total;
+
+	static void store_max(std::atomic<uint64_t> &p_max, uint64_t p_value);
+public:
+	void add_block(uint64_t p_ns, uint32_t p_frames, uint32_t p_sample_rate, bool p_dampened);
+	void add_rebuild(uint64_t p_ns);
+
+	void reset();
+	EngineStatsSnapshot get_snapshot() const;
+
+	static EngineStats *get_total(EngineStatsKind p_kind);
+
+	EngineStats(EngineStatsKind p_kind);
+	EngineStats();
+	~EngineStats() {}
+};
+
+#endif // ENGINE_STATS_H
\ No newline at end of file
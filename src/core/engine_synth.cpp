@@ -0,0 +1,828 @@
+#include "engine_synth.h"
+#include "engine_utils.h"
+
+void EngineSynth::build_engine() {
+	engine_valid = false;
+	engine_dirty = true;
+
+	if (!engine) {
+		engine = new EngineMain();
+	}
+
+	if (!dc_filter) {
+		dc_filter = new LowPassFilter(
+			dc_filter_frequency, params.sample_rate
+		);
+	} else {
+		dc_filter->modify(
+			dc_filter_frequency, params.sample_rate
+		);
+	}
+
+	uint64_t start = engine_stats_now();
+	engine->build(params);
+	stats->add_rebuild(engine_stats_now() - start);
+
+	engine_dirty = false;
+	delays_dirty = false;
+	engine_valid = true;
+}
+
+void EngineSynth::request_engine() {
+	if (!rebuilder) {
+		rebuilder = new EngineRebuilder();
+		rebuilder->stats = stats;
+		rebuilder->preheat = [this](EngineMain *p_engine, uint32_t p_frames, float p_inc) {
+			preheat_engine(p_engine, p_frames, p_inc);
+		};
+	}
+
+	float inc = render_rpm / (params.sample_rate * 120.f);
+	float preheat_time = rebuild_preheat_time;
+	if (render_rpm > 0.f && preheat_time < REBUILD_PREHEAT_MIN_CYCLES * 120.f / render_rpm) {
+		preheat_time = REBUILD_PREHEAT_MIN_CYCLES * 120.f / render_rpm;
+	}
+	preheat_time = preheat_time < REBUILD_PREHEAT_MAX_TIME ? preheat_time : REBUILD_PREHEAT_MAX_TIME;
+	uint32_t preheat_frames = (uint32_t)(preheat_time * params.sample_rate);
+	rebuilder->request(params, engine->crankshaft_phase, inc, preheat_frames);
+
+	engine_dirty = false;
+	delays_dirty = false;
+}
+
+// Runs on the rebuild worker, only touches p_engine
+void EngineSynth::preheat_engine(EngineMain *p_engine, uint32_t p_frames, float inc) {
+	float intake_channel[WAVEGUIDE_MAX_BLOCK];
+	float vibrations_channel[WAVEGUIDE_MAX_BLOCK];
+	float exhaust_channel[WAVEGUIDE_MAX_BLOCK];
+
+	uint32_t max_block = p_engine->waveguides->get_max_block();
+	uint32_t frame = 0;
+	while (frame < p_frames) {
+		uint32_t frames = p_frames - frame < max_block ? p_frames - frame : max_block;
+		bool channels_dampened;
+		gen_block(p_engine, intake_channel, vibrations_channel, exhaust_channel, frames, inc, channels_dampened);
+		frame += frames;
+	}
+}
+
+bool EngineSynth::update_pipe_delay(uint32_t guide, float length) {
+	WaveGuideBank *waveguides = engine->waveguides;
+	float delay = distance_to_delay(length, params.sample_rate);
+	if (delay > waveguides->get_max_delay(guide)) {
+		return false;
+	}
+
+	// Pipes keep the whole sample delay they were built with until their length is automated
+	float built_delay = engine->waveguide_delays[guide];
+	if (delay != built_delay || waveguides->get_delay(guide) != std::floor(built_delay)) {
+		waveguides->set_delay(guide, delay);
+	}
+	return true;
+}
+
+void EngineSynth::update_delays() {
+	delays_dirty = false;
+	if (!engine_valid) {
+		engine_dirty = true;
+		return;
+	}
+
+	uint32_t cylinder_count = params.cylinders.size();
+	uint32_t muffler_count = params.muffler_cavity_lengths.size();
+
+	// Elements were added or removed, the layout has to be rebuilt
+	if (cylinder_count != engine->cylinders.size() || muffler_count != engine->muffler->muffler_elements.size()) {
+		engine_dirty = true;
+		return;
+	}
+
+	// Pipes longer than their delay line need a rebuild too
+	bool fits = true;
+
+	for (uint32_t i = 0; i < cylinder_count && fits; i++) {
+		const EngineCylinderParams &cyl_params = params.cylinders[i];
+
+		EngineCylinder *cyl = engine->cylinders[i];
+		fits = update_pipe_delay(cyl->intake_waveguide, cyl_params.intake_pipe_length) &&
+			update_pipe_delay(cyl->exhaust_waveguide, cyl_params.exhaust_pipe_length) &&
+			update_pipe_delay(cyl->extractor_waveguide, cyl_params.extractor_pipe_length);
+	}
+
+	fits = fits && update_pipe_delay(engine->muffler->straight_pipe, params.straight_pipe_length);
+
+	for (uint32_t i = 0; i < muffler_count && fits; i++) {
+		fits = update_pipe_delay(engine->muffler->muffler_elements[i], params.muffler_cavity_lengths[i]);
+	}
+
+	engine->waveguides->update_min_delay();
+
+	if (!fits) {
+		engine_dirty = true;
+	}
+}
+
+bool EngineSynth::update_engine() {
+	if (delays_dirty && !engine_dirty) {
+		update_delays();
+	}
+	if (engine_dirty) {
+		// Keep playing the current engine while the new one is built
+		if (background_rebuild && engine_valid) {
+			request_engine();
+		} else {
+			build_engine();
+		}
+	}
+
+	return engine_valid;
+}
+
+void EngineSynth::gen(EngineMain *p_engine, float &intake_channel, float &vibrations_channel, float &exhaust_channel, bool &channels_dampened) {
+	// float noise_cos = Math::cos(p_engine->noise_pos * (float)Math_TAU) * 500.f;
+	// float noise_sin = Math::cos(p_engine->noise_pos * (float)Math_TAU) * 500.f;
+	// p_engine->intake_noise->set_repeat((int32_t)(500.f * intake_noise_frequency));
+	// p_engine->crankshaft_noise->set_repeat((int32_t)(500.f * crankshaft_fluctuation_frequency));
+	float intake_noise = p_engine->intake_noise_lp->next(
+		p_engine->intake_noise
+		// p_engine->intake_noise->get(
+		// 	p_engine->noise_pos * 500.f * intake_noise_frequency,
+		// 	0.f
+		// )
+	) * p_engine->intake_noise_factor;
+
+	float vibrations = 0.0;
+
+	size_t cylinder_count = p_engine->cylinders.size();
+	float num_cyl = (float)cylinder_count;
+
+	float last_exhaust_collector = p_engine->exhaust_collector / num_cyl;
+	p_engine->exhaust_collector = 0.0;
+	p_engine->intake_collector = 0.0;
+
+	float crankshaft_fluctuation_off = p_engine->crankshaft_fluctuation_lp->next(
+		p_engine->crankshaft_noise
+		// p_engine->crankshaft_noise->get(
+		// 	p_engine->noise_pos * 500.f * crankshaft_fluctuation_frequency,
+		// 	0.f
+		// )
+	);
+
+	bool cylinder_dampened = false;
+
+	WaveGuideBank *waveguides = p_engine->waveguides;
+
+	for (size_t i = 0; i < cylinder_count; i++) {
+		EngineCylinder *cylinder = p_engine->cylinders[i];
+
+		float cyl_intake;
+		float cyl_exhaust;
+		float cyl_vib;
+		bool cyl_dampened;
+		cylinder->pop(
+			waveguides,
+			p_engine->crankshaft_phase +
+				crank_to_phase(p_engine->crankshaft_fluctuation * crankshaft_fluctuation_off),
+			last_exhaust_collector,
+			p_engine->intake_valve_shift,
+			p_engine->exhaust_valve_shift,
+			cyl_intake, cyl_exhaust, cyl_vib, cyl_dampened
+		);
+
+		p_engine->intake_collector += cyl_intake;
+		p_engine->exhaust_collector += cyl_exhaust;
+
+		vibrations += cyl_vib;
+		cylinder_dampened = cylinder_dampened || cyl_dampened;
+	}
+
+	float straight_pipe_c1, straight_pipe_c0;
+	bool straight_pipe_dampened;
+	waveguides->pop(p_engine->muffler->straight_pipe, straight_pipe_c1, straight_pipe_c0, straight_pipe_dampened);
+
+	float muffler_c1 = 0.0, muffler_c0 = 0.0;
+	bool muffler_dampened = false;
+
+	size_t muffler_count = p_engine->muffler->muffler_elements.size();
+
+	for (size_t i = 0; i < muffler_count; i++) {
+		uint32_t muffler_line = p_engine->muffler->muffler_elements[i];
+		float muffler_line_c1, muffler_line_c0;
+		bool muffler_line_dampened;
+		waveguides->pop(muffler_line, muffler_line_c1, muffler_line_c0, muffler_line_dampened);
+		muffler_c1 += muffler_line_c1;
+		muffler_c0 += muffler_line_c0;
+		muffler_dampened = muffler_dampened || muffler_line_dampened;
+	}
+
+	for (size_t i = 0; i < cylinder_count; i++) {
+		EngineCylinder *cylinder = p_engine->cylinders[i];
+
+		cylinder->push(
+			waveguides,
+			p_engine->intake_collector / num_cyl +
+				intake_noise * intake_valve_phase(p_engine->crankshaft_phase + cylinder->crank_offset)
+		);
+	}
+
+	waveguides->push(
+		p_engine->muffler->straight_pipe, p_engine->exhaust_collector, muffler_c1
+	);
+	p_engine->exhaust_collector += straight_pipe_c1;
+
+	float num_muffler = (float)muffler_count;
+
+	for (size_t i = 0; i < muffler_count; i++) {
+		uint32_t muffler_delay_line = p_engine->muffler->muffler_elements[i];
+		waveguides->push(muffler_delay_line, straight_pipe_c0 / num_muffler, 0.0);
+	}
+
+	vibrations = p_engine->vibration_filter->filter(vibrations);
+
+	intake_channel = p_engine->intake_collector;
+	vibrations_channel = vibrations;
+	exhaust_channel = muffler_c0;
+	channels_dampened = straight_pipe_dampened || cylinder_dampened;
+}
+
+void EngineSynth::gen_block(EngineMain *p_engine, float *intake_channel, float *vibrations_channel, float *exhaust_channel, uint32_t frames, float inc, bool &channels_dampened) {
+	WaveGuideBank *waveguides = p_engine->waveguides;
+	EngineMuffler *muffler = p_engine->muffler;
+
+	size_t cylinder_count = p_engine->cylinders.size();
+	size_t muffler_count = muffler->muffler_elements.size();
+	float num_cyl = (float)cylinder_count;
+	float num_muffler = (float)muffler_count;
+
+	uint32_t crank_phase[WAVEGUIDE_MAX_BLOCK];
+	uint32_t fluctuated_crank_phase[WAVEGUIDE_MAX_BLOCK];
+	float intake_noise[WAVEGUIDE_MAX_BLOCK];
+	float crankshaft_noise[WAVEGUIDE_MAX_BLOCK];
+	float intake_collector[WAVEGUIDE_MAX_BLOCK];
+	float exhaust_collector[WAVEGUIDE_MAX_BLOCK];
+	float last_exhaust_collector[WAVEGUIDE_MAX_BLOCK];
+	float straight_pipe_c1[WAVEGUIDE_MAX_BLOCK];
+	float straight_pipe_c0[WAVEGUIDE_MAX_BLOCK];
+	float muffler_c1[WAVEGUIDE_MAX_BLOCK];
+
+	uint32_t phase_inc = crank_to_phase(inc);
+
+	p_engine->intake_noise_lp->fill(p_engine->intake_noise, intake_noise, frames);
+	p_engine->crankshaft_fluctuation_lp->fill(p_engine->crankshaft_noise, crankshaft_noise, frames);
+
+	// Crankshaft position, this carries state from frame to frame
+	for (uint32_t i = 0; i < frames; i++) {
+		p_engine->crankshaft_phase += phase_inc;
+		p_engine->noise_pos = std::fmod(p_engine->noise_pos + inc / 500.f, 1.f);
+
+		intake_noise[i] *= p_engine->intake_noise_factor;
+
+		float crankshaft_fluctuation_off = crankshaft_noise[i];
+
+		crank_phase[i] = p_engine->crankshaft_phase;
+		fluctuated_crank_phase[i] = p_engine->crankshaft_phase +
+			crank_to_phase(p_engine->crankshaft_fluctuation * crankshaft_fluctuation_off);
+	}
+
+	// Read every delay line for the whole block, cylinder guides into their lanes
+	CylinderBank *lanes = p_engine->cylinder_lanes;
+	uint32_t stride = lanes->lanes;
+	bool cylinder_dampened = false;
+
+	for (uint32_t i = 0; i < cylinder_count; i++) {
+		EngineCylinder *cylinder = p_engine->cylinders[i];
+		bool ex_dampened, in_dampened, ext_dampened;
+
+		waveguides->read_block(cylinder->exhaust_waveguide, frames, lanes->ex_c1 + i, lanes->ex_c0 + i, stride, ex_dampened);
+		waveguides->read_block(cylinder->intake_waveguide, frames, lanes->in_c1 + i, lanes->in_c0 + i, stride, in_dampened);
+		waveguides->read_block(cylinder->extractor_waveguide, frames, lanes->ext_c1 + i, lanes->ext_c0 + i, stride, ext_dampened);
+
+		cylinder_dampened = cylinder_dampened || ex_dampened || in_dampened || ext_dampened;
+	}
+
+	bool straight_pipe_dampened;
+	waveguides->read_block(muffler->straight_pipe, frames, straight_pipe_dampened);
+
+	for (size_t i = 0; i < muffler_count; i++) {
+		bool muffler_line_dampened;
+		waveguides->read_block(muffler->muffler_elements[i], frames, muffler_line_dampened);
+	}
+
+	// Collectors
+	for (uint32_t i = 0; i < frames; i++) {
+		intake_collector[i] = 0.0f;
+		exhaust_collector[i] = 0.0f;
+		vibrations_channel[i] = 0.0f;
+		exhaust_channel[i] = 0.0f;
+		muffler_c1[i] = 0.0f;
+	}
+
+	for (uint32_t i = 0; i < cylinder_count; i++) {
+		float in_c0_gain = 1.0f - std::abs(lanes->intake_beta[i]);
+		float ext_c0_gain = 1.0f - std::abs(lanes->extractor_beta[i]);
+
+		for (uint32_t j = 0; j < frames; j++) {
+			intake_collector[j] += lanes->in_c0[j * stride + i] * in_c0_gain;
+			exhaust_collector[j] += lanes->ext_c0[j * stride + i] * ext_c0_gain;
+		}
+	}
+
+	{
+		uint32_t guide = muffler->straight_pipe;
+		const float *c1 = waveguides->get_block_c1(guide);
+		const float *c0 = waveguides->get_block_c0(guide);
+		float c1_gain = 1.0f - std::abs(waveguides->alpha[guide]);
+		float c0_gain = 1.0f - std::abs(waveguides->beta[guide]);
+
+		for (uint32_t j = 0; j < frames; j++) {
+			straight_pipe_c1[j] = c1[j] * c1_gain;
+			straight_pipe_c0[j] = c0[j] * c0_gain;
+		}
+	}
+
+	for (size_t i = 0; i < muffler_count; i++) {
+		uint32_t guide = muffler->muffler_elements[i];
+		const float *c1 = waveguides->get_block_c1(guide);
+		const float *c0 = waveguides->get_block_c0(guide);
+		float c1_gain = 1.0f - std::abs(waveguides->alpha[guide]);
+		float c0_gain = 1.0f - std::abs(waveguides->beta[guide]);
+
+		for (uint32_t j = 0; j < frames; j++) {
+			muffler_c1[j] += c1[j] * c1_gain;
+			exhaust_channel[j] += c0[j] * c0_gain;
+		}
+	}
+
+	// Extractors are fed with the collector of the previous frame
+	{
+		float collector = p_engine->exhaust_collector;
+		for (uint32_t i = 0; i < frames; i++) {
+			last_exhaust_collector[i] = collector / num_cyl;
+			collector = exhaust_collector[i] + straight_pipe_c1[i];
+		}
+		p_engine->exhaust_collector = collector;
+		p_engine->intake_collector = intake_collector[frames - 1];
+	}
+
+	// Cylinders, several per instruction
+	lanes->process_block(
+		frames, crank_phase, fluctuated_crank_phase,
+		intake_noise, intake_collector, last_exhaust_collector,
+		p_engine->intake_valve_shift, p_engine->exhaust_valve_shift
+	);
+
+	for (uint32_t j = 0; j < frames; j++) {
+		const float *cyl_sound = lanes->cyl_sound + j * stride;
+		for (uint32_t i = 0; i < stride; i++) {
+			vibrations_channel[j] += cyl_sound[i];
+		}
+	}
+
+	for (uint32_t i = 0; i < cylinder_count; i++) {
+		EngineCylinder *cylinder = p_engine->cylinders[i];
+
+		waveguides->write_block(cylinder->exhaust_waveguide, frames, lanes->ex_in0 + i, lanes->ex_in1 + i, stride);
+		waveguides->write_block(cylinder->intake_waveguide, frames, lanes->in_in0 + i, lanes->in_in1 + i, stride);
+		waveguides->write_block(cylinder->extractor_waveguide, frames, lanes->ext_in0 + i, lanes->ext_in1 + i, stride);
+
+		waveguides->alpha[cylinder->exhaust_waveguide] = lanes->exhaust_alpha[i];
+		waveguides->alpha[cylinder->intake_waveguide] = lanes->intake_alpha[i];
+	}
+
+	// Muffler
+	{
+		uint32_t guide = muffler->straight_pipe;
+		const float *c1 = waveguides->get_block_c1(guide);
+		const float *c0 = waveguides->get_block_c0(guide);
+		float *in0 = waveguides->get_block_in0(guide);
+		float *in1 = waveguides->get_block_in1(guide);
+		float alpha = waveguides->alpha[guide];
+		float beta = waveguides->beta[guide];
+
+		for (uint32_t j = 0; j < frames; j++) {
+			in0[j] = c1[j] * alpha + exhaust_collector[j];
+			in1[j] = c0[j] * beta + muffler_c1[j];
+		}
+	}
+
+	for (size_t i = 0; i < muffler_count; i++) {
+		uint32_t guide = muffler->muffler_elements[i];
+		const float *c1 = waveguides->get_block_c1(guide);
+		const float *c0 = waveguides->get_block_c0(guide);
+		float *in0 = waveguides->get_block_in0(guide);
+		float *in1 = waveguides->get_block_in1(guide);
+		float alpha = waveguides->alpha[guide];
+		float beta = waveguides->beta[guide];
+
+		for (uint32_t j = 0; j < frames; j++) {
+			in0[j] = c1[j] * alpha + straight_pipe_c0[j] / num_muffler;
+			in1[j] = c0[j] * beta + 0.0f;
+		}
+	}
+
+	waveguides->write_block(muffler->straight_pipe, frames);
+	for (size_t i = 0; i < muffler_count; i++) {
+		waveguides->write_block(muffler->muffler_elements[i], frames);
+	}
+
+	for (uint32_t i = 0; i < frames; i++) {
+		vibrations_channel[i] = p_engine->vibration_filter->filter(vibrations_channel[i]);
+		intake_channel[i] = intake_collector[i];
+	}
+
+	channels_dampened = straight_pipe_dampened || cylinder_dampened;
+}
+
+uint32_t EngineSynth::get_block_frames(EngineMain *p_engine, uint32_t p_max_frames) const {
+	uint32_t frames = p_max_frames < WAVEGUIDE_MAX_BLOCK ? p_max_frames : WAVEGUIDE_MAX_BLOCK;
+
+	if (block_processing) {
+		uint32_t max_block = p_engine->waveguides->get_max_block();
+		frames = frames < max_block ? frames : max_block;
+	}
+
+	return frames;
+}
+
+uint32_t EngineSynth::render_frames(EngineMain *p_engine, float *p_intake, float *p_vibrations, float *p_exhaust, uint32_t p_max_frames, float inc) {
+	uint32_t frames = get_block_frames(p_engine, p_max_frames);
+	bool channels_dampened = false;
+
+	if (block_processing) {
+		gen_block(p_engine, p_intake, p_vibrations, p_exhaust, frames, inc, channels_dampened);
+	} else {
+		uint32_t phase_inc = crank_to_phase(inc);
+
+		// Per sample reference path
+		for (uint32_t frame = 0; frame < frames; frame++) {
+			p_engine->crankshaft_phase += phase_inc;
+			p_engine->noise_pos = std::fmod(p_engine->noise_pos + inc / 500.f, 1.f);
+
+			bool frame_dampened;
+			gen(p_engine, p_intake[frame], p_vibrations[frame], p_exhaust[frame], frame_dampened);
+
+			channels_dampened = channels_dampened || frame_dampened;
+		}
+	}
+
+	waveguides_dampened = waveguides_dampened || channels_dampened;
+
+	return frames;
+}
+
+uint32_t EngineSynth::render_block(float *p_intake, float *p_vibrations, float *p_exhaust, uint32_t p_max_frames, float inc) {
+	if (rebuilder && !fading_engine && !next_engine) {
+		next_engine = rebuilder->take();
+		next_engine_wait = 0;
+	}
+
+	// Swap in the engine built in the background once the current one is at the crank
+	// phase it was preheated to, so the waves in its pipes match the cylinders. Gives up
+	// waiting after a second, when the rpm is too low to get there.
+	if (next_engine) {
+		uint32_t phase_inc = crank_to_phase(inc);
+		uint32_t distance = next_engine->crankshaft_phase - engine->crankshaft_phase;
+		uint32_t frames_to_phase = phase_inc > 0 ? distance / phase_inc : 0;
+
+		if (frames_to_phase == 0 || next_engine_wait >= params.sample_rate) {
+			next_engine->crankshaft_phase = engine->crankshaft_phase;
+			next_engine->noise_pos = engine->noise_pos;
+			next_engine->intake_noise->seek(engine->intake_noise->get_position());
+			next_engine->crankshaft_noise->seek(engine->crankshaft_noise->get_position());
+			next_engine->intake_noise_lp->copy_state(engine->intake_noise_lp);
+			next_engine->crankshaft_fluctuation_lp->copy_state(engine->crankshaft_fluctuation_lp);
+
+			fading_engine = engine;
+			engine = next_engine;
+			next_engine = nullptr;
+			crossfade_pos = 0;
+			crossfade_len = rebuild_crossfade_frames;
+
+			// Pipe lengths may have changed while it was being built
+			delays_dirty = true;
+		} else {
+			p_max_frames = p_max_frames < frames_to_phase ? p_max_frames : frames_to_phase;
+		}
+	}
+
+	if (fading_engine && crossfade_pos >= crossfade_len) {
+		rebuilder->retire(fading_engine);
+		fading_engine = nullptr;
+	}
+
+	if (!fading_engine) {
+		uint32_t frames = render_frames(engine, p_intake, p_vibrations, p_exhaust, p_max_frames, inc);
+		if (next_engine) {
+			next_engine_wait += frames;
+		}
+		return frames;
+	}
+
+	uint32_t frames = get_block_frames(engine, p_max_frames);
+	frames = get_block_frames(fading_engine, frames);
+	frames = frames < crossfade_len - crossfade_pos ? frames : crossfade_len - crossfade_pos;
+
+	float fading_intake[WAVEGUIDE_MAX_BLOCK];
+	float fading_vibrations[WAVEGUIDE_MAX_BLOCK];
+	float fading_exhaust[WAVEGUIDE_MAX_BLOCK];
+
+	render_frames(fading_engine, fading_intake, fading_vibrations, fading_exhaust, frames, inc);
+	render_frames(engine, p_intake, p_vibrations, p_exhaust, frames, inc);
+
+	float step = 1.f / (float)crossfade_len;
+	for (uint32_t i = 0; i < frames; i++) {
+		float t = (float)(crossfade_pos + i + 1) * step;
+
+		p_intake[i] = fading_intake[i] + (p_intake[i] - fading_intake[i]) * t;
+		p_vibrations[i] = fading_vibrations[i] + (p_vibrations[i] - fading_vibrations[i]) * t;
+		p_exhaust[i] = fading_exhaust[i] + (p_exhaust[i] - fading_exhaust[i]) * t;
+	}
+
+	crossfade_pos += frames;
+
+	return frames;
+}
+
+void EngineSynth::clear_buffer() {
+	if (!update_engine()) {
+		return;
+	}
+
+	if (fading_engine) {
+		rebuilder->retire(fading_engine);
+		fading_engine = nullptr;
+	}
+
+	// Nothing to line up with after a clear
+	if (next_engine) {
+		rebuilder->retire(engine);
+		engine = next_engine;
+		next_engine = nullptr;
+		update_delays();
+	}
+
+	engine->clear();
+	dc_filter->clear();
+
+	if (resampler) {
+		resampler->clear();
+	}
+}
+
+bool EngineSynth::update_resampler() {
+	if (output_sample_rate == 0 || output_sample_rate == params.sample_rate) {
+		return false;
+	}
+
+	if (!resampler) {
+		resampler = new EngineResampler();
+	}
+	if (!resampler->is_configured(params.sample_rate, output_sample_rate, resampler_quality)) {
+		resampler->configure(params.sample_rate, output_sample_rate, resampler_quality, WAVEGUIDE_MAX_BLOCK);
+	}
+
+	return true;
+}
+
+void EngineSynth::fill_buffer(float *p_buffer, int p_num_frames, int p_num_channels) {
+	uint64_t start = engine_stats_now();
+	if (!update_engine()) {
+		return;
+	}
+
+	dc_filter->modify(
+		dc_filter_frequency, params.sample_rate
+	);
+
+	waveguides_dampened = false;
+
+	float intake_channel[WAVEGUIDE_MAX_BLOCK];
+	float vibrations_channel[WAVEGUIDE_MAX_BLOCK];
+	float exhaust_channel[WAVEGUIDE_MAX_BLOCK];
+	float mixed[WAVEGUIDE_MAX_BLOCK];
+
+	bool resampling = update_resampler();
+
+	int frame = 0;
+	while (frame < p_num_frames) {
+		// Drain what the resampler has before rendering more
+		if (resampling) {
+			frame += (int)resampler->pop(p_buffer + frame * p_num_channels, (uint32_t)(p_num_frames - frame), p_num_channels);
+			if (frame >= p_num_frames) break;
+		}
+
+		const EngineControlState &state = controls->read();
+		float inc = state.rpm / (params.sample_rate * 120.f);
+		render_rpm = state.rpm;
+
+		uint32_t frames = render_block(
+			intake_channel, vibrations_channel, exhaust_channel,
+			resampling ? WAVEGUIDE_MAX_BLOCK : (uint32_t)(p_num_frames - frame), inc
+		);
+
+		for (uint32_t i = 0; i < frames; i++) {
+			mixed[i] = (
+				intake_channel[i] * state.intake_volume +
+				vibrations_channel[i] * state.vibrations_volume +
+				exhaust_channel[i] * state.exhaust_volume
+			) * state.volume;
+		}
+
+		for (uint32_t i = 0; i < frames; i++) {
+			mixed[i] -= dc_filter->filter(mixed[i]);
+		}
+
+		if (resampling) {
+			resampler->push(mixed, frames);
+			continue;
+		}
+
+		float *out = p_buffer + frame * p_num_channels;
+		for (uint32_t i = 0; i < frames; i++) {
+			for (int c = 0; c < p_num_channels; c++) {
+				out[i * p_num_channels + c] = mixed[i];
+			}
+		}
+
+		frame += (int)frames;
+	}
+
+	stats->add_block(engine_stats_now() - start, p_num_frames, resampling ? output_sample_rate : params.sample_rate, waveguides_dampened);
+}
+
+void EngineSynth::fill_channel_buffers(float *p_intake_buffer, float *p_vibration_buffer, float *p_exhaust_buffer, int p_num_frames, int p_num_channels) {
+	uint64_t start = engine_stats_now();
+	if (!update_engine()) {
+		return;
+	}
+
+	waveguides_dampened = false;
+
+	float intake_channel[WAVEGUIDE_MAX_BLOCK];
+	float vibrations_channel[WAVEGUIDE_MAX_BLOCK];
+	float exhaust_channel[WAVEGUIDE_MAX_BLOCK];
+
+	int frame = 0;
+	while (frame < p_num_frames) {
+		const EngineControlState &state = controls->read();
+		float inc = state.rpm / (params.sample_rate * 120.f);
+		render_rpm = state.rpm;
+
+		float intake_gain = state.intake_volume * state.volume;
+		float vibrations_gain = state.vibrations_volume * state.volume;
+		float exhaust_gain = state.exhaust_volume * state.volume;
+
+		uint32_t frames = render_block(
+			intake_channel, vibrations_channel, exhaust_channel,
+			(uint32_t)(p_num_frames - frame), inc
+		);
+
+		for (uint32_t i = 0; i < frames; i++) {
+			intake_channel[i] *= intake_gain;
+			vibrations_channel[i] *= vibrations_gain;
+			exhaust_channel[i] *= exhaust_gain;
+		}
+
+		float *intake_out = p_intake_buffer + frame * p_num_channels;
+		float *vibration_out = p_vibration_buffer + frame * p_num_channels;
+		float *exhaust_out = p_exhaust_buffer + frame * p_num_channels;
+		for (uint32_t i = 0; i < frames; i++) {
+			for (int c = 0; c < p_num_channels; c++) {
+				intake_out[i * p_num_channels + c] = intake_channel[i];
+				vibration_out[i * p_num_channels + c] = vibrations_channel[i];
+				exhaust_out[i * p_num_channels + c] = exhaust_channel[i];
+			}
+		}
+
+		frame += (int)frames;
+	}
+
+	stats->add_block(engine_stats_now() - start, p_num_frames, params.sample_rate, waveguides_dampened);
+}
+
+void EngineSynth::skip_frames(int p_num_frames) {
+	uint64_t start = engine_stats_now();
+	if (!update_engine()) {
+		return;
+	}
+	
+	dc_filter->modify(
+		dc_filter_frequency, params.sample_rate
+	);
+
+	waveguides_dampened = false;
+
+	float intake_channel[WAVEGUIDE_MAX_BLOCK];
+	float vibrations_channel[WAVEGUIDE_MAX_BLOCK];
+	float exhaust_channel[WAVEGUIDE_MAX_BLOCK];
+
+	int frame = 0;
+	while (frame < p_num_frames) {
+		const EngineControlState &state = controls->read();
+		float inc = state.rpm / (params.sample_rate * 120.f);
+		render_rpm = state.rpm;
+
+		uint32_t frames = render_block(
+			intake_channel, vibrations_channel, exhaust_channel,
+			(uint32_t)(p_num_frames - frame), inc
+		);
+
+		for (uint32_t i = 0; i < frames; i++) {
+			float mixed = (
+				intake_channel[i] * state.intake_volume +
+				vibrations_channel[i] * state.vibrations_volume +
+				exhaust_channel[i] * state.exhaust_volume
+			) * state.volume;
+
+			dc_filter->filter(mixed);
+		}
+
+		frame += (int)frames;
+	}
+
+	stats->add_block(engine_stats_now() - start, p_num_frames, params.sample_rate, waveguides_dampened);
+}
+
+float EngineSynth::get_crank_phase() {
+	if (!update_engine()) {
+		return 0.f;
+	}
+
+	return phase_to_crank(engine->crankshaft_phase);
+}
+
+void EngineSynth::set_crank_phase(float p_phase) {
+	if (!update_engine()) {
+		return;
+	}
+
+	engine->crankshaft_phase = crank_to_phase(p_phase);
+	if (fading_engine) {
+		fading_engine->crankshaft_phase = engine->crankshaft_phase;
+	}
+}
+
+EngineSynth::EngineSynth() {
+	controls = new EngineControls();
+	controls->state.rpm = 1000.f;
+	controls->state.volume = 0.5f;
+	controls->state.intake_volume = 0.5f;
+	controls->state.exhaust_volume = 0.25f;
+	controls->state.vibrations_volume = 0.1f;
+	controls->publish();
+	dc_filter_frequency = 0.5f;
+	block_processing = true;
+	background_rebuild = true;
+	rebuild_crossfade_frames = 1024;
+	rebuild_preheat_time = 0.5f;
+	output_sample_rate = 0;
+	resampler_quality = RESAMPLER_QUALITY_MEDIUM;
+
+	engine = nullptr;
+	engine_valid = false;
+	dc_filter = nullptr;
+	engine_dirty = true;
+	delays_dirty = false;
+
+	rebuilder = nullptr;
+	next_engine = nullptr;
+	next_engine_wait = 0;
+	fading_engine = nullptr;
+	crossfade_pos = 0;
+	crossfade_len = 0;
+	render_rpm = controls->state.rpm;
+
+	resampler = nullptr;
+	waveguides_dampened = false;
+	stats = new EngineStats(ENGINE_STATS_CONFIG);
+}
+
+EngineSynth::~EngineSynth() {
+	// Stops the worker before the engines it may still be building are gone
+	if (rebuilder) {
+		delete rebuilder;
+	}
+
+	if (next_engine) {
+		delete next_engine;
+	}
+
+	if (fading_engine) {
+		delete fading_engine;
+	}
+
+	if (engine) {
+		delete engine;
+	}
+
+	delete controls;
+	delete stats;
+
+	if (dc_filter) {
+		delete dc_filter;
+	}
+
+	if (resampler) {
+		delete resampler;
+	}
+}
\ No newline at end of file
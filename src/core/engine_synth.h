@@ -0,0 +1,93 @@
+#ifndef ENGINE_SYNTH_H
+#define ENGINE_SYNTH_H
+
+#include <cstdint>
+#include "engine_parts.h"
+#include "engine_resampler.h"
+#include "engine_stats.h"
+
+// Background rebuilds preheat the new engine for rebuild_preheat_time, at least this
+// many engine cycles and at most REBUILD_PREHEAT_MAX_TIME seconds
+#define REBUILD_PREHEAT_MIN_CYCLES 4
+#define REBUILD_PREHEAT_MAX_TIME 2.0f
+
+// The waveguide engine and its renderer, without any Godot types. The owner fills
+// params and calls mark_dirty() after layout changes or mark_delays_dirty() when only
+// pipe lengths changed, the engine is rebuilt or retuned at the start of the next render.
+// EngineConfig wraps it as a Resource, the command line renderer drives it directly.
+class EngineSynth {
+private:
+	EngineMain *engine;
+	bool engine_valid;
+	LowPassFilter *dc_filter;
+	bool engine_dirty;
+	bool delays_dirty;
+
+	// Background rebuilds, the previous engine fades out while the new one fades in.
+	// A built engine waits in next_engine until the current one reaches its crank phase.
+	EngineRebuilder *rebuilder;
+	EngineMain *next_engine;
+	uint32_t next_engine_wait;
+	EngineMain *fading_engine;
+	uint32_t crossfade_pos;
+	uint32_t crossfade_len;
+
+	// Rpm of the last rendered block, background rebuilds are preheated at it
+	float render_rpm;
+
+	EngineResampler *resampler;
+	bool waveguides_dampened;
+
+	void build_engine();
+	void request_engine();
+	void preheat_engine(EngineMain *p_engine, uint32_t p_frames, float inc);
+	void update_delays();
+	bool update_pipe_delay(uint32_t guide, float length);
+	bool update_resampler();
+	void gen(EngineMain *p_engine, float &intake_channel, float &vibrations_channel, float &exhaust_channel, bool &channels_dampened);
+	void gen_block(EngineMain *p_engine, float *intake_channel, float *vibrations_channel, float *exhaust_channel, uint32_t frames, float inc, bool &channels_dampened);
+	uint32_t get_block_frames(EngineMain *p_engine, uint32_t p_max_frames) const;
+	uint32_t render_frames(EngineMain *p_engine, float *p_intake, float *p_vibrations, float *p_exhaust, uint32_t p_max_frames, float inc);
+	uint32_t render_block(float *p_intake, float *p_vibrations, float *p_exhaust, uint32_t p_max_frames, float inc);
+public:
+	EngineParams params;
+
+	// Mix, rpm and volumes live in the real time controls
+	EngineControls *controls;
+	float dc_filter_frequency;
+
+	// fill_buffer output, the model keeps running at params.sample_rate. 0 outputs at that rate.
+	uint32_t output_sample_rate;
+	int resampler_quality;
+	bool block_processing;
+	bool background_rebuild;
+	uint32_t rebuild_crossfade_frames;
+	float rebuild_preheat_time;
+
+	void mark_dirty() {engine_dirty = true;}
+	void mark_delays_dirty() {delays_dirty = true;}
+	bool is_engine_dirty() const {return engine_dirty;}
+
+	// Applies pending changes, false when there is no engine to render with
+	bool update_engine();
+
+	bool get_waveguides_dampened() const {return waveguides_dampened;}
+
+	// Time spent in the fill calls and in rebuilds, foreground or background
+	EngineStats *stats;
+
+	// Generation
+	void clear_buffer();
+	void fill_buffer(float *p_buffer, int p_num_frames, int p_num_channels);
+	void fill_channel_buffers(float *p_intake_buffer, float *p_vibration_buffer, float *p_exhaust_buffer, int p_num_frames, int p_num_channels);
+	void skip_frames(int p_num_frames);
+
+	// Crank position in turns of the engine cycle
+	float get_crank_phase();
+	void set_crank_phase(float p_phase);
+
+	EngineSynth();
+	~EngineSynth();
+};
+
+#endif // ENGINE_SYNTH_H
\ No newline at end of file
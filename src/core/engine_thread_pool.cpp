@@ -0,0 +1,144 @@
+#include "engine_thread_pool.h"
+
+void EngineThreadPool::resize(uint32_t thread_count) {
+	if (thread_count == 0) {
+		thread_count = std::thread::hardware_concurrency();
+		thread_count = thread_count > 0 ? thread_count : 1;
+	}
+	if (thread_count == queues.size()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	start_cond.notify_all();
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+	threads.clear();
+
+	for (size_t i = 0; i < queues.size(); i++) {
+		delete queues[i];
+	}
+	queues.clear();
+
+	quit = false;
+
+	for (uint32_t i = 0; i < thread_count; i++) {
+		queues.push_back(new Queue());
+	}
+
+	// Queue 0 belongs to the thread calling run
+	for (uint32_t i = 1; i < thread_count; i++) {
+		threads.push_back(std::thread(&EngineThreadPool::worker_loop, this, i, generation));
+	}
+}
+
+void EngineThreadPool::run(uint32_t task_count, const std::function<void(uint32_t)> &task) {
+	if (threads.empty() || task_count <= 1) {
+		for (uint32_t i = 0; i < task_count; i++) {
+			task(i);
+		}
+		return;
+	}
+
+	uint32_t queue_count = (uint32_t)queues.size();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (uint32_t i = 0; i < queue_count; i++) {
+			std::lock_guard<std::mutex> queue_lock(queues[i]->mutex);
+			queues[i]->begin = (uint32_t)((uint64_t)task_count * i / queue_count);
+			queues[i]->end = (uint32_t)((uint64_t)task_count * (i + 1) / queue_count);
+		}
+
+		this->task = &task;
+		active = (uint32_t)threads.size();
+		generation++;
+	}
+	start_cond.notify_all();
+
+	work(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done_cond.wait(lock, [this] {return active == 0;});
+	this->task = nullptr;
+}
+
+bool EngineThreadPool::pop(uint32_t worker, uint32_t &index) {
+	Queue *queue = queues[worker];
+	std::lock_guard<std::mutex> lock(queue->mutex);
+
+	if (queue->begin == queue->end) return false;
+
+	index = queue->begin++;
+	return true;
+}
+
+bool EngineThreadPool::steal(uint32_t worker, uint32_t &index) {
+	uint32_t queue_count = (uint32_t)queues.size();
+
+	for (uint32_t i = 1; i < queue_count; i++) {
+		Queue *queue = queues[(worker + i) % queue_count];
+		std::lock_guard<std::mutex> lock(queue->mutex);
+
+		if (queue->begin != queue->end) {
+			index = --queue->end;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void EngineThreadPool::work(uint32_t worker) {
+	uint32_t index;
+	while (pop(worker, index) || steal(worker, index)) {
+		(*task)(index);
+	}
+}
+
+void EngineThreadPool::worker_loop(uint32_t worker, uint64_t seen_generation) {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		start_cond.wait(lock, [this, seen_generation] {
+			return quit || generation != seen_generation;
+		});
+		if (quit) return;
+
+		seen_generation = generation;
+
+		lock.unlock();
+		work(worker);
+		lock.lock();
+
+		if (--active == 0) {
+			done_cond.notify_one();
+		}
+	}
+}
+
+EngineThreadPool::EngineThreadPool() {
+	this->generation = 0;
+	this->active = 0;
+	this->quit = false;
+	this->task = nullptr;
+}
+
+EngineThreadPool::~EngineThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	start_cond.notify_all();
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+
+	for (size_t i = 0; i < queues.size(); i++) {
+		delete queues[i];
+	}
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef ENGINE_THREAD_POOL_H
+#define ENGINE_THREAD_POOL_H
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Runs batches of independent tasks on a fixed set of threads. Every thread starts on
+// its own contiguous share of the batch and steals from the end of the others' shares
+// once it runs out. The calling thread works too, so a pool of one thread runs
+// everything inline.
+class EngineThreadPool {
+public:
+	class Queue {
+	public:
+		std::mutex mutex;
+		uint32_t begin;
+		uint32_t end;
+
+		Queue() {begin = 0; end = 0;}
+	};
+
+	std::vector<std::thread> threads;
+	std::vector<Queue *> queues;
+
+	std::mutex mutex;
+	std::condition_variable start_cond;
+	std::condition_variable done_cond;
+	uint64_t generation;
+	uint32_t active;
+	bool quit;
+	const std::function<void(uint32_t)> *task;
+
+	// Thread count including the calling thread, 0 picks one per hardware thread
+	void resize(uint32_t thread_count);
+	uint32_t get_thread_count() const {return (uint32_t)queues.size();}
+
+	// Calls task(i) for every i below task_count and returns once all of them are done
+	void run(uint32_t task_count, const std::function<void(uint32_t)> &task);
+
+	bool pop(uint32_t worker, uint32_t &index);
+	bool steal(uint32_t worker, uint32_t &index);
+	void work(uint32_t worker);
+	void worker_loop(uint32_t worker, uint64_t seen_generation);
+
+	EngineThreadPool();
+	~EngineThreadPool();
+};
+
+#endif // ENGINE_THREAD_POOL_H
\ No newline at end of file
@@ -0,0 +1,200 @@
+#ifndef ENGINE_UTILS_H
+#define ENGINE_UTILS_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include "engine_simd.h"
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#define SPEED_OF_SOUND 343.0f
+#define ENGINE_PI 3.1415926535897932384626433833
+#define PI2F (2.0f * (float)ENGINE_PI)
+#define PI4F (4.0f * (float)ENGINE_PI)
+#define CACHE_LINE_SIZE 64
+
+inline float exhaust_valve(float crank_pos) {
+	if (0.75 < crank_pos && crank_pos < 1.0) {
+		return -std::sin(crank_pos * PI4F);
+	}
+	return 0.0;
+}
+
+inline float intake_valve(float crank_pos) {
+	if (0.0 < crank_pos && crank_pos < 0.25) {
+		return std::sin(crank_pos * PI4F);
+	}
+	return 0.f;
+}
+
+inline float fuel_ignition(float crank_pos, float timing) {
+	if (0.5 < crank_pos && crank_pos < timing * 0.5 + 0.5) {
+		return std::sin(PI2F * ((crank_pos - 0.5f) / timing));
+	}
+	return 0.f;
+}
+
+inline float piston_motion(float crank_pos) {
+	return std::cos(crank_pos * PI4F);
+}
+
+// Crank positions as 32 bit fixed point turns of the engine cycle. Offsets and
+// shifts become integer adds and wrap around the cycle on their own.
+#define CRANK_PHASE_QUARTER 0x40000000u
+#define CRANK_PHASE_HALF 0x80000000u
+
+// Keeps the fractional part of the position, like fmod but also for negative ones
+inline uint32_t crank_to_phase(float crank_pos) {
+	double turns = (double)crank_pos;
+	return (uint32_t)(uint64_t)((turns - std::floor(turns)) * 4294967296.0);
+}
+
+inline float phase_to_crank(uint32_t phase) {
+	return (float)(phase >> 8) * (1.0f / 16777216.0f);
+}
+
+// Curve tables
+//
+// The curves above sampled with ENGINE_CURVE_SIZE intervals per table and linearly
+// interpolated. piston_motion uses one period of cosine, the valves and fuel_ignition
+// share a half period of sine stretched over their active window. Window edges fall on
+// table nodes, so linear interpolation error stays within h^2 / 8 * max|f''|:
+//   piston_motion: (2 * pi / ENGINE_CURVE_SIZE)^2 / 8, 2.9e-7 for 4096 intervals
+//   valves, fuel_ignition: (pi / ENGINE_CURVE_SIZE)^2 / 8, 7.4e-8 for 4096 intervals
+// plus float rounding of the interpolation (around 1e-7).
+// Tables are built once and shared by every engine in the process.
+#ifndef ENGINE_CURVE_BITS
+#define ENGINE_CURVE_BITS 12
+#endif
+#define ENGINE_CURVE_SIZE (1u << ENGINE_CURVE_BITS)
+
+class CurveTables {
+public:
+	float piston[ENGINE_CURVE_SIZE + 1];
+	float half_sine[ENGINE_CURVE_SIZE + 1];
+
+	static const CurveTables &get() {
+		static CurveTables tables;
+		return tables;
+	}
+
+private:
+	CurveTables() {
+		for (uint32_t i = 0; i <= ENGINE_CURVE_SIZE; i++) {
+			double t = (double)i / ENGINE_CURVE_SIZE;
+			piston[i] = (float)std::cos(t * 2.0 * ENGINE_PI);
+			half_sine[i] = (float)std::sin(t * ENGINE_PI);
+		}
+	}
+};
+
+// pos spans the whole table over 32 bits
+inline float curve_lookup(const float *table, uint32_t pos) {
+	uint32_t i = pos >> (32 - ENGINE_CURVE_BITS);
+	float t = (float)((pos << ENGINE_CURVE_BITS) >> 8) * (1.0f / 16777216.0f);
+	return table[i] + (table[i + 1] - table[i]) * t;
+}
+
+inline float exhaust_valve_phase(uint32_t crank_phase) {
+	uint32_t pos = crank_phase - 3 * CRANK_PHASE_QUARTER;
+	if (crank_phase > 3 * CRANK_PHASE_QUARTER) {
+		return curve_lookup(CurveTables::get().half_sine, pos << 2);
+	}
+	return 0.f;
+}
+
+inline float intake_valve_phase(uint32_t crank_phase) {
+	if (crank_phase < CRANK_PHASE_QUARTER) {
+		return curve_lookup(CurveTables::get().half_sine, crank_phase << 2);
+	}
+	return 0.f;
+}
+
+// The ignition window only changes with the timing, compute it once per timing
+inline void ignition_window(float timing, uint32_t &window_len, float &window_scale) {
+	if (timing <= 0.f) {
+		window_len = 0;
+		window_scale = 0.f;
+		return;
+	}
+	double len = timing * 0.5 * 4294967296.0;
+	window_len = len < (double)CRANK_PHASE_HALF ? (uint32_t)len : CRANK_PHASE_HALF;
+	window_scale = (float)(ENGINE_CURVE_SIZE / len);
+}
+
+inline float fuel_ignition_phase(uint32_t crank_phase, uint32_t window_len, float window_scale) {
+	uint32_t pos = crank_phase - CRANK_PHASE_HALF;
+	if (crank_phase > CRANK_PHASE_HALF && pos < window_len) {
+		const float *table = CurveTables::get().half_sine;
+		float u = (float)pos * window_scale;
+		uint32_t i = (uint32_t)u;
+		if (i >= ENGINE_CURVE_SIZE) return 0.f;
+		float t = u - (float)i;
+		return table[i] + (table[i + 1] - table[i]) * t;
+	}
+	return 0.f;
+}
+
+inline float piston_motion_phase(uint32_t crank_phase) {
+	return curve_lookup(CurveTables::get().piston, crank_phase << 1);
+}
+
+// Vector versions of the curves above, evaluated on ENGINE_SIMD_LANES crank positions
+inline vfloat v_exhaust_valve(vfloat crank_pos) {
+	vmask open = v_and(v_gt(crank_pos, v_set(0.75f)), v_lt(crank_pos, v_set(1.0f)));
+	return v_mask(open, v_sub(v_set(0.0f), v_sin_turns(v_add(crank_pos, crank_pos))));
+}
+
+inline vfloat v_intake_valve(vfloat crank_pos) {
+	vmask open = v_and(v_gt(crank_pos, v_set(0.0f)), v_lt(crank_pos, v_set(0.25f)));
+	return v_mask(open, v_sin_turns(v_add(crank_pos, crank_pos)));
+}
+
+inline vfloat v_fuel_ignition(vfloat crank_pos, vfloat timing) {
+	vmask burning = v_and(
+		v_gt(crank_pos, v_set(0.5f)),
+		v_lt(crank_pos, v_add(v_mul(timing, v_set(0.5f)), v_set(0.5f)))
+	);
+	return v_mask(burning, v_sin_turns(v_div(v_sub(crank_pos, v_set(0.5f)), timing)));
+}
+
+inline vfloat v_piston_motion(vfloat crank_pos) {
+	return v_cos_turns(v_add(crank_pos, crank_pos));
+}
+
+// Fractional waveguide delay of a pipe, a sample shorter than the pipe like the
+// integer length delay lines it replaces. Built engines round it down to whole
+// samples, only automated pipes play the fraction.
+inline float distance_to_delay(float meters, uint32_t sample_rate) {
+	float delay = meters / SPEED_OF_SOUND * (float)sample_rate - 1.0f;
+	return delay > 1.0f ? delay : 1.0f;
+}
+
+inline uint32_t align_count(uint32_t count, uint32_t alignment) {
+	return (count + alignment - 1) / alignment * alignment;
+}
+
+inline void *aligned_malloc(size_t size) {
+	if (size == 0) size = CACHE_LINE_SIZE;
+#ifdef _WIN32
+	return _aligned_malloc(size, CACHE_LINE_SIZE);
+#else
+	void *ptr = nullptr;
+	if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0) {
+		return nullptr;
+	}
+	return ptr;
+#endif
+}
+
+inline void aligned_free(void *ptr) {
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+#endif // ENGINE_UTILS_H
\ No newline at end of file
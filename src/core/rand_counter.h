@@ -0,0 +1,101 @@
+#ifndef RAND_COUNTER_H
+#define RAND_COUNTER_H
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include "engine_simd.h"
+
+// Mixed into the key, so two streams seeded alike are still independent
+enum NoiseStream {
+	NOISE_STREAM_INTAKE = 1,
+	NOISE_STREAM_CRANKSHAFT = 2,
+};
+
+// Counter based white noise in [-1, 1). Sample n is a hash of n and the stream key, the
+// only state is the position, so blocks are filled with SIMD and the samples don't depend
+// on how rendering is split into blocks or threads. Repeats after 2^32 samples.
+class CounterNoise {
+private:
+	uint32_t key0;
+	uint32_t key1;
+	uint32_t position;
+
+	// lowbias32, a bijective 32 bit integer hash
+	static uint32_t mix(uint32_t x) {
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	static vint v_mix(vint x) {
+		x = vi_xor(x, vi_shr(x, 16));
+		x = vi_mul(x, vi_set(0x7feb352du));
+		x = vi_xor(x, vi_shr(x, 15));
+		x = vi_mul(x, vi_set(0x846ca68bu));
+		x = vi_xor(x, vi_shr(x, 16));
+		return x;
+	}
+
+	static uint32_t split_mix(uint64_t &state) {
+		uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return (uint32_t)((z ^ (z >> 31)) >> 32);
+	}
+public:
+	// Sample n of the stream, the key goes in before and between the rounds so streams
+	// are not shifted copies of each other
+	float get(uint32_t n) const {
+		return (float)((int32_t)mix(mix(n ^ key0) + key1) >> 8) * (1.0f / 8388608.0f);
+	}
+
+	float next_f32() {
+		return get(position++);
+	}
+
+	void fill(float *p_out, uint32_t p_count) {
+		const vint k0 = vi_set(key0);
+		const vint k1 = vi_set(key1);
+		const vint step = vi_set(ENGINE_SIMD_LANES);
+		vint n = vi_add(vi_set(position), vi_lane_index());
+
+		uint32_t i = 0;
+		for (; i + ENGINE_SIMD_LANES <= p_count; i += ENGINE_SIMD_LANES) {
+			v_storeu(p_out + i, v_bits_to_signed(v_mix(vi_add(v_mix(vi_xor(n, k0)), k1))));
+			n = vi_add(n, step);
+		}
+		for (; i < p_count; i++) {
+			p_out[i] = get(position + i);
+		}
+
+		position += p_count;
+	}
+
+	uint32_t get_position() const {return position;}
+	void seek(uint32_t p_position) {position = p_position;}
+
+	// The same seed and stream always give the same samples
+	void set_seed(uint32_t seed, uint32_t stream) {
+		uint64_t state = ((uint64_t)stream << 32) | seed;
+		key0 = split_mix(state);
+		key1 = split_mix(state);
+		position = 0;
+	}
+
+	// Seeds from the clock, generators created at the same time still differ
+	void set_random_seed(uint32_t stream) {
+		static std::atomic<uint32_t> instances(0);
+		uint64_t now = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+		set_seed((uint32_t)(now ^ (now >> 32)) ^ (instances.fetch_add(1) * 0x9e3779b9u), stream);
+	}
+
+	CounterNoise(uint32_t stream) {
+		set_random_seed(stream);
+	}
+};
+
+#endif // RAND_COUNTER_H
\ No newline at end of file
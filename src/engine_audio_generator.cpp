@@ -1,4 +1,5 @@
 #include "engine_audio_generator.h"
+#include "engine_audio_monitors.h"
 #include <GodotGlobal.hpp>
 #include <iostream>
 
@@ -14,32 +15,69 @@ bool EngineAudioGenerator::validate_config() {
 }
 
 void EngineAudioGenerator::fill_buffer(int p_max_frames) {
-	ERR_FAIL_COND(!validate_config());
+	if (prepare_buffer(p_max_frames) <= 0) return;
+
+	render_buffer();
+	push_rendered_buffer();
+}
+
+int EngineAudioGenerator::prepare_buffer(int p_max_frames) {
+	uint64_t start = engine_stats_now();
+	render_frames = 0;
+
+	ERR_FAIL_COND_V(!validate_config(), 0);
 	
 	int frames = (int)playback->get_frames_available();
 
 	frames = frames < p_max_frames ? frames : p_max_frames;
 
-	if (frames <= 0) return;
+	if (frames <= 0) return 0;
 
-	ERR_FAIL_COND(!playback->can_push_buffer(frames));
+	ERR_FAIL_COND_V(!playback->can_push_buffer(frames), 0);
 
-	PoolVector2Array buffer;
-	buffer.resize(frames);
-	PoolVector2Array::Write buf = buffer.write();
+	// The model runs at its own rate and gets resampled to the stream's
+	engine_config->set_output_sample_rate((uint32_t)stream->get_mix_rate());
+
+	if (render_data.size() < (size_t)frames * 2) {
+		render_data.resize((size_t)frames * 2);
+	}
+	render_frames = frames;
+	block_ns = engine_stats_now() - start;
+
+	return frames;
+}
+
+void EngineAudioGenerator::render_buffer() {
+	if (render_frames <= 0) return;
 
-	engine_config->fill_buffer((float *)buf.ptr(), frames, 2);
+	uint64_t start = engine_stats_now();
+	engine_config->get_synth()->fill_buffer(render_data.data(), render_frames, 2);
+	block_ns += engine_stats_now() - start;
+}
+
+void EngineAudioGenerator::push_rendered_buffer() {
+	int frames = render_frames;
+	render_frames = 0;
+
+	if (frames <= 0) return;
 
-	float dt = 1.f / engine_config->get_sample_rate();
+	uint64_t start = engine_stats_now();
+	const float *data = render_data.data();
+
+	float dt = 1.f / stream->get_mix_rate();
 	float compensation_lerp = Math::clamp(dt / 1.f, 0.f, 1.f);
 	float max_mix = 0.f;
 
 	for (int i = 0; i < frames; i++) {
-		float l = buf[i].x;
-		float r = buf[i].y;
+		float l = data[i * 2 + 0];
+		float r = data[i * 2 + 1];
 		float mix = std::abs(l) > std::abs(r) ? l : r;
 		max_mix = mix > max_mix ? mix : max_mix;
 	}
+
+	PoolVector2Array buffer;
+	buffer.resize(frames);
+	PoolVector2Array::Write buf = buffer.write();
 	
 	for (int i = 0; i < frames; i++) {
 		float desired_vol = 1.f;
@@ -48,12 +86,18 @@ void EngineAudioGenerator::fill_buffer(int p_max_frames) {
 		}
 		compensation_volume += Math::clamp(desired_vol - compensation_volume, -compensation_lerp, compensation_lerp);
 
-		buf[i] *= compensation_volume;
+		buf[i] = Vector2(data[i * 2 + 0], data[i * 2 + 1]) * compensation_volume;
 	}
 
 	waveguides_dampened = engine_config->get_waveguides_dampened();
 
 	playback->push_buffer(buffer);
+
+	stats->add_block(block_ns + engine_stats_now() - start, (uint32_t)frames, (uint32_t)stream->get_mix_rate(), waveguides_dampened);
+}
+
+Dictionary EngineAudioGenerator::get_render_stats() const {
+	return EngineAudioMonitors::snapshot_to_dictionary(stats->get_snapshot());
 }
 
 void EngineAudioGenerator::_init() {
@@ -82,11 +126,16 @@ void EngineAudioGenerator::_register_methods() {
 	
 	register_method("fill_buffer", &EngineAudioGenerator::fill_buffer);
 	register_method("get_waveguides_dampened", &EngineAudioGenerator::get_waveguides_dampened);
+	register_method("get_render_stats", &EngineAudioGenerator::get_render_stats);
+	register_method("reset_render_stats", &EngineAudioGenerator::reset_render_stats);
 }
 
 EngineAudioGenerator::EngineAudioGenerator() {
 	this->waveguides_dampened = false;
 	this->compensation_volume = 1.f;
+	this->render_frames = 0;
+	this->stats = new EngineStats(ENGINE_STATS_GENERATOR);
+	this->block_ns = 0;
 
 	this->stream = Ref<AudioStreamGenerator>();
 	this->playback = Ref<AudioStreamGeneratorPlayback>();
@@ -94,5 +143,5 @@ EngineAudioGenerator::EngineAudioGenerator() {
 }
 
 EngineAudioGenerator::~EngineAudioGenerator() {
-	
+	delete stats;
 }
\ No newline at end of file
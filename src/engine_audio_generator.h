@@ -20,6 +20,13 @@ private:
 	Ref<AudioStreamGeneratorPlayback> playback;
 	Ref<EngineConfig> engine_config;
 
+	std::vector<float> render_data;
+	int render_frames;
+
+	// Time of the current block so far, the steps may run on different threads
+	EngineStats *stats;
+	uint64_t block_ns;
+
 	bool validate_config();
 public:
 	static void _register_methods();
@@ -40,8 +47,20 @@ public:
 
 	bool get_waveguides_dampened() const {return waveguides_dampened;}
 
+	Dictionary get_render_stats() const;
+	void reset_render_stats() {stats->reset();}
+
 	void fill_buffer(int p_max_frames);
 
+	// fill_buffer split in steps for EngineRenderScheduler. prepare_buffer and
+	// push_rendered_buffer talk to the playback and have to run on the main thread,
+	// prepare_buffer also applies pending config changes. render_buffer only touches
+	// this generator's synth and can run on any thread, but not at the same time as
+	// another generator sharing the config.
+	int prepare_buffer(int p_max_frames);
+	void render_buffer();
+	void push_rendered_buffer();
+
 	void _init();
 
 	EngineAudioGenerator();
@@ -0,0 +1,259 @@
+#include "engine_audio_hybrid.h"
+#include <GodotGlobal.hpp>
+#include <Math.hpp>
+
+using namespace godot;
+
+bool EngineAudioHybrid::is_model_valid() {
+	return engine_config.is_valid() && engine_config->is_engine_valid();
+}
+
+bool EngineAudioHybrid::is_bank_valid() {
+	if (!player.is_valid()) return false;
+
+	player->update_dirty_channels();
+	return player->has_samples();
+}
+
+void EngineAudioHybrid::update_player() {
+	if (!engine_config.is_valid()) return;
+
+	// The bank is recorded with the channels at unit volume, the engine
+	// configuration keeps the rpm and mix for both paths
+	player->set_rpm(engine_config->get_rpm());
+	player->set_master_volume(engine_config->get_volume());
+	player->set_crankshaft_volume(engine_config->get_vibrations_volume());
+	player->set_ignition_volume(engine_config->get_intake_volume());
+	player->set_exhaust_volume(engine_config->get_exhaust_volume());
+}
+
+void EngineAudioHybrid::switch_to(bool p_model) {
+	uint32_t len = (uint32_t)Math::max(crossfade_time * stream->get_mix_rate(), 1.0f);
+
+	if (crossfade_pos < crossfade_len) {
+		// Still fading, turn the running crossfade around
+		crossfade_pos = (uint32_t)((uint64_t)(crossfade_len - crossfade_pos) * len / crossfade_len);
+	} else {
+		// The incoming path has been silent, start it on the crank of the outgoing one
+		if (p_model) {
+			float rps = engine_config->get_rpm() / 120.0f;
+			float sample_rate = (float)engine_config->get_sample_rate();
+			int preheat_frames = (int)(preheat_time * sample_rate);
+			if (rps > 0) {
+				int preheat_cycles = (int)Math::max(preheat_time * rps, (float)REBUILD_PREHEAT_MIN_CYCLES);
+				preheat_frames = (int)((preheat_cycles / rps) * sample_rate);
+			}
+
+			engine_config->clear_buffer();
+			engine_config->skip_frames(Math::max(preheat_frames, 1));
+			engine_config->set_crank_phase(player->get_crank_phase());
+		} else {
+			update_player();
+			player->skip_blend();
+			player->set_crank_phase(engine_config->get_crank_phase());
+		}
+		crossfade_pos = 0;
+	}
+
+	crossfade_len = len;
+	use_model = p_model;
+}
+
+void EngineAudioHybrid::bake_bank() {
+	ERR_FAIL_COND(!engine_config.is_valid());
+	ERR_FAIL_COND(!engine_config->is_engine_valid());
+
+	if (!recorder.is_valid()) {
+		recorder.instance();
+	}
+
+	Ref<EngineConfig> bank_config = engine_config->duplicate();
+	ERR_FAIL_COND(!bank_config.is_valid());
+
+	bank_config->set_volume(1);
+	bank_config->set_intake_volume(1);
+	bank_config->set_vibrations_volume(1);
+	bank_config->set_exhaust_volume(1);
+
+	recorder->set_engine_configuration(bank_config);
+	recorder->record();
+
+	if (!player.is_valid()) {
+		player.instance();
+	}
+
+	player->set_crankshaft_stream(recorder->get_crankshaft_recording());
+	player->set_ignition_stream(recorder->get_ignition_recording());
+	player->set_exhaust_stream(recorder->get_exhaust_recording());
+}
+
+void EngineAudioHybrid::fill_buffer(int p_max_frames) {
+	ERR_FAIL_COND(!playback.is_valid());
+	ERR_FAIL_COND(!stream.is_valid());
+
+	bool model_valid = is_model_valid();
+	bool bank_valid = is_bank_valid();
+
+	ERR_FAIL_COND(!model_valid && !bank_valid);
+
+	bool want_model = use_model;
+	if (!bank_valid) {
+		want_model = true;
+	} else if (!model_valid) {
+		want_model = false;
+	} else if (use_model && importance < model_threshold - threshold_hysteresis) {
+		want_model = false;
+	} else if (!use_model && importance > model_threshold + threshold_hysteresis) {
+		want_model = true;
+	}
+
+	if (want_model != use_model) {
+		switch_to(want_model);
+	}
+
+	// Without the other path there is nothing to fade from
+	if (!model_valid || !bank_valid) {
+		crossfade_pos = crossfade_len;
+	}
+
+	int frames = (int)playback->get_frames_available();
+
+	frames = frames < p_max_frames ? frames : p_max_frames;
+
+	if (frames <= 0) return;
+
+	ERR_FAIL_COND(!playback->can_push_buffer(frames));
+
+	bool fading = crossfade_pos < crossfade_len;
+	bool render_model = use_model || fading;
+	bool render_bank = !use_model || fading;
+
+	if (render_model) {
+		if (model_data.size() < (size_t)frames * 2) {
+			model_data.resize((size_t)frames * 2);
+		}
+		engine_config->set_output_sample_rate((uint32_t)stream->get_mix_rate());
+		engine_config->fill_buffer(model_data.data(), frames, 2);
+	}
+
+	if (render_bank) {
+		if (bank_data.size() < (size_t)frames) {
+			bank_data.resize((size_t)frames);
+		}
+		update_player();
+		player->mix_frames(bank_data.data(), (uint32_t)frames, stream->get_mix_rate());
+	}
+
+	PoolVector2Array buffer;
+	buffer.resize(frames);
+	PoolVector2Array::Write buf = buffer.write();
+
+	for (int i = 0; i < frames; i++) {
+		float model_gain = use_model ? 1.f : 0.f;
+		if (crossfade_pos < crossfade_len) {
+			crossfade_pos++;
+			float t = crossfade_pos / (float)crossfade_len;
+			model_gain = use_model ? t : 1.f - t;
+		}
+
+		Vector2 model = render_model ? Vector2(model_data[i * 2 + 0], model_data[i * 2 + 1]) : Vector2();
+		Vector2 bank = render_bank ? bank_data[i] : Vector2();
+
+		buf[i] = bank + (model - bank) * model_gain;
+	}
+
+	playback->push_buffer(buffer);
+}
+
+void EngineAudioHybrid::_init() {
+
+}
+
+void EngineAudioHybrid::_register_methods() {
+	register_property<EngineAudioHybrid, Ref<AudioStreamGenerator>>(
+		"stream",
+		&EngineAudioHybrid::set_stream,
+		&EngineAudioHybrid::get_stream,
+		Ref<AudioStreamGenerator>()
+	);
+	register_property<EngineAudioHybrid, Ref<AudioStreamGeneratorPlayback>>(
+		"playback",
+		&EngineAudioHybrid::set_playback,
+		&EngineAudioHybrid::get_playback,
+		Ref<AudioStreamGeneratorPlayback>()
+	);
+	register_property<EngineAudioHybrid, Ref<EngineConfig>>(
+		"engine_configuration",
+		&EngineAudioHybrid::set_engine_configuration,
+		&EngineAudioHybrid::get_engine_configuration,
+		Ref<EngineConfig>()
+	);
+	register_property<EngineAudioHybrid, Ref<EngineAudioPlayer>>(
+		"player",
+		&EngineAudioHybrid::set_player,
+		&EngineAudioHybrid::get_player,
+		Ref<EngineAudioPlayer>()
+	);
+	register_property<EngineAudioHybrid, Ref<EngineAudioRecorder>>(
+		"recorder",
+		&EngineAudioHybrid::set_recorder,
+		&EngineAudioHybrid::get_recorder,
+		Ref<EngineAudioRecorder>()
+	);
+	register_property<EngineAudioHybrid, float>(
+		"importance",
+		&EngineAudioHybrid::set_importance,
+		&EngineAudioHybrid::get_importance,
+		1
+	);
+	register_property<EngineAudioHybrid, float>(
+		"model_threshold",
+		&EngineAudioHybrid::set_model_threshold,
+		&EngineAudioHybrid::get_model_threshold,
+		0.5
+	);
+	register_property<EngineAudioHybrid, float>(
+		"threshold_hysteresis",
+		&EngineAudioHybrid::set_threshold_hysteresis,
+		&EngineAudioHybrid::get_threshold_hysteresis,
+		0.05
+	);
+	register_property<EngineAudioHybrid, float>(
+		"crossfade_time",
+		&EngineAudioHybrid::set_crossfade_time,
+		&EngineAudioHybrid::get_crossfade_time,
+		0.1
+	);
+	register_property<EngineAudioHybrid, float>(
+		"preheat_time",
+		&EngineAudioHybrid::set_preheat_time,
+		&EngineAudioHybrid::get_preheat_time,
+		0.5
+	);
+
+	register_method("bake_bank", &EngineAudioHybrid::bake_bank);
+	register_method("fill_buffer", &EngineAudioHybrid::fill_buffer);
+	register_method("is_using_model", &EngineAudioHybrid::is_using_model);
+}
+
+EngineAudioHybrid::EngineAudioHybrid() {
+	this->importance = 1;
+	this->model_threshold = 0.5;
+	this->threshold_hysteresis = 0.05;
+	this->crossfade_time = 0.1;
+	this->preheat_time = 0.5;
+
+	this->use_model = true;
+	this->crossfade_pos = 0;
+	this->crossfade_len = 0;
+
+	this->stream = Ref<AudioStreamGenerator>();
+	this->playback = Ref<AudioStreamGeneratorPlayback>();
+	this->engine_config = Ref<EngineConfig>();
+	this->player = Ref<EngineAudioPlayer>();
+	this->recorder = Ref<EngineAudioRecorder>();
+}
+
+EngineAudioHybrid::~EngineAudioHybrid() {
+
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#ifndef ENGINE_AUDIO_HYBRID_H
+#define ENGINE_AUDIO_HYBRID_H
+
+#include <Godot.hpp>
+#include <Reference.hpp>
+#include <Ref.hpp>
+#include <AudioStreamGenerator.hpp>
+#include <AudioStreamGeneratorPlayback.hpp>
+#include "engine_config.h"
+#include "engine_audio_player.h"
+#include "engine_audio_recorder.h"
+
+namespace godot {
+
+// A single engine voice that renders through the physical model when it matters
+// and through a recorded bank of the same config when it doesn't. Switching
+// lines up the crank phase of both and crossfades between them.
+class EngineAudioHybrid : public Reference {
+	GODOT_CLASS(EngineAudioHybrid, Reference)
+private:
+	Ref<AudioStreamGenerator> stream;
+	Ref<AudioStreamGeneratorPlayback> playback;
+	Ref<EngineConfig> engine_config;
+	Ref<EngineAudioPlayer> player;
+	Ref<EngineAudioRecorder> recorder;
+
+	// Above model_threshold + threshold_hysteresis the model takes over, below
+	// model_threshold - threshold_hysteresis the bank does
+	float importance;
+	float model_threshold;
+	float threshold_hysteresis;
+	float crossfade_time;
+
+	// The model runs this long at the current rpm, in whole engine cycles, before it
+	// fades in, so it doesn't start with empty pipes
+	float preheat_time;
+
+	bool use_model;
+	uint32_t crossfade_pos;
+	uint32_t crossfade_len;
+
+	std::vector<float> model_data;
+	std::vector<Vector2> bank_data;
+
+	bool is_model_valid();
+	bool is_bank_valid();
+	void update_player();
+	void switch_to(bool p_model);
+public:
+	static void _register_methods();
+
+	void set_stream(Ref<AudioStreamGenerator> p_stream) {stream = p_stream;}
+	Ref<AudioStreamGenerator> get_stream() {return stream;}
+
+	void set_playback(Ref<AudioStreamGeneratorPlayback> p_playback) {playback = p_playback;}
+	Ref<AudioStreamGeneratorPlayback> get_playback() {return playback;}
+
+	void set_engine_configuration(Ref<EngineConfig> p_config) {
+		engine_config = p_config;
+		if (p_config.is_valid()) {
+			p_config->mark_dirty();
+		}
+	}
+	Ref<EngineConfig> get_engine_configuration() const {return engine_config;}
+
+	void set_player(Ref<EngineAudioPlayer> p_player) {player = p_player;}
+	Ref<EngineAudioPlayer> get_player() const {return player;}
+
+	void set_recorder(Ref<EngineAudioRecorder> p_recorder) {recorder = p_recorder;}
+	Ref<EngineAudioRecorder> get_recorder() const {return recorder;}
+
+	void set_importance(float p_importance) {importance = p_importance;}
+	float get_importance() const {return importance;}
+
+	void set_model_threshold(float p_threshold) {model_threshold = p_threshold;}
+	float get_model_threshold() const {return model_threshold;}
+
+	void set_threshold_hysteresis(float p_hysteresis) {threshold_hysteresis = p_hysteresis;}
+	float get_threshold_hysteresis() const {return threshold_hysteresis;}
+
+	void set_crossfade_time(float p_time) {crossfade_time = p_time;}
+	float get_crossfade_time() const {return crossfade_time;}
+
+	void set_preheat_time(float p_time) {preheat_time = p_time;}
+	float get_preheat_time() const {return preheat_time;}
+
+	bool is_using_model() const {return use_model;}
+
+	// Records the bank from the engine configuration with the recorder settings
+	void bake_bank();
+
+	void fill_buffer(int p_max_frames);
+
+	void _init();
+
+	EngineAudioHybrid();
+	~EngineAudioHybrid();
+};
+
+}
+
+#endif // ENGINE_AUDIO_HYBRID_H
\ No newline at end of file
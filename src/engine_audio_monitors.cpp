@@ -0,0 +1,60 @@
+#include "engine_audio_monitors.h"
+#include <GodotGlobal.hpp>
+
+using namespace godot;
+
+static EngineStats *get_kind_total(String p_kind) {
+	if (p_kind == "config") return EngineStats::get_total(ENGINE_STATS_CONFIG);
+	if (p_kind == "generator") return EngineStats::get_total(ENGINE_STATS_GENERATOR);
+	if (p_kind == "player") return EngineStats::get_total(ENGINE_STATS_PLAYER);
+	return nullptr;
+}
+
+Dictionary EngineAudioMonitors::snapshot_to_dictionary(const EngineStatsSnapshot &p_snapshot) {
+	Dictionary stats;
+
+	stats["blocks"] = (int64_t)p_snapshot.blocks;
+	stats["frames"] = (int64_t)p_snapshot.frames;
+	stats["average_block_usec"] = p_snapshot.get_average_block_usec();
+	stats["max_block_usec"] = p_snapshot.get_max_block_usec();
+	stats["realtime_factor"] = p_snapshot.get_realtime_factor();
+	stats["load"] = p_snapshot.get_load();
+	stats["frames_per_second"] = p_snapshot.get_frames_per_second();
+	stats["dampened_blocks"] = (int64_t)p_snapshot.dampened_blocks;
+	stats["rebuilds"] = (int64_t)p_snapshot.rebuilds;
+	stats["average_rebuild_msec"] = p_snapshot.get_average_rebuild_msec();
+	stats["max_rebuild_msec"] = p_snapshot.get_max_rebuild_msec();
+
+	return stats;
+}
+
+Dictionary EngineAudioMonitors::get_render_stats(String p_kind) {
+	EngineStats *total = get_kind_total(p_kind);
+	ERR_FAIL_COND_V(!total, Dictionary());
+
+	return snapshot_to_dictionary(total->get_snapshot());
+}
+
+void EngineAudioMonitors::reset_render_stats(String p_kind) {
+	EngineStats *total = get_kind_total(p_kind);
+	ERR_FAIL_COND(!total);
+
+	total->reset();
+}
+
+void EngineAudioMonitors::_init() {
+	
+}
+
+void EngineAudioMonitors::_register_methods() {
+	register_method("get_render_stats", &EngineAudioMonitors::get_render_stats);
+	register_method("reset_render_stats", &EngineAudioMonitors::reset_render_stats);
+}
+
+EngineAudioMonitors::EngineAudioMonitors() {
+	
+}
+
+EngineAudioMonitors::~EngineAudioMonitors() {
+	
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef ENGINE_AUDIO_MONITORS_H
+#define ENGINE_AUDIO_MONITORS_H
+
+#include <Godot.hpp>
+#include <Reference.hpp>
+#include <Dictionary.hpp>
+#include "engine_stats.h"
+
+namespace godot {
+
+// Render timing summed over every instance of a kind: "config" for EngineConfig renders,
+// "generator" for EngineAudioGenerator blocks and "player" for EngineAudioPlayer. Godot 3
+// has no custom Performance monitors, a debug overlay polls get_render_stats instead.
+class EngineAudioMonitors : public Reference {
+	GODOT_CLASS(EngineAudioMonitors, Reference)
+public:
+	static void _register_methods();
+
+	// Also used by the per instance get_render_stats of the renderers
+	static Dictionary snapshot_to_dictionary(const EngineStatsSnapshot &p_snapshot);
+
+	Dictionary get_render_stats(String p_kind);
+	void reset_render_stats(String p_kind);
+
+	void _init();
+
+	EngineAudioMonitors();
+	~EngineAudioMonitors();
+};
+
+}
+
+#endif // ENGINE_AUDIO_MONITORS_H
\ No newline at end of file
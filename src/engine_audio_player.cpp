@@ -1,18 +1,25 @@
 #include "engine_audio_player.h"
+#include "engine_audio_monitors.h"
 #include <Math.hpp>
+#include <File.hpp>
+#include <ProjectSettings.hpp>
+#include <mutex>
+#include <unordered_map>
 
 using namespace godot;
 
-void EngineAudioPlayer::update_channel(EngineAudioChannel *channel, Ref<AudioStreamSample> stream) {
-	bool channel_valid = false;
+EngineAudioPlayer::EngineAudioBank *EngineAudioPlayer::load_bank(Ref<AudioStreamSample> stream) {
+	EngineAudioBank *bank = new EngineAudioBank();
+	bool bank_valid = false;
 
 	int start_off = 0;
 	
 	if (stream.is_valid()) {
-		// Supports only 16 bit pcm stereo file
-		if (stream->get_format() == AudioStreamSample::FORMAT_16_BITS && stream->is_stereo()) {
+		// Supports only 16 bit pcm, mono or stereo
+		if (stream->get_format() == AudioStreamSample::FORMAT_16_BITS) {
+			int channels = stream->is_stereo() ? 2 : 1;
 			PoolByteArray data = stream->get_data();
-			if (data.size() > 4) {
+			if (data.size() >= 20) {
 				// Read data
 				PoolByteArray::Read data_read = data.read();
 				uint16_t *buffer = (uint16_t *)data_read.ptr();
@@ -30,71 +37,69 @@ void EngineAudioPlayer::update_channel(EngineAudioChannel *channel, Ref<AudioStr
 						// Get padding frames
 						uint32_t padding_frames = (uint32_t)(buffer[8]) | ((uint32_t)(buffer[9]) << 16);
 
-						// Move buffer
-						buffer = buffer + 10;
-						start_off += 5;
-
-						// Construct array of frames
-						if (channel->frames) {
-							delete[] channel->frames;
-						}
-						channel->frames = new Vector2[data_size / 4];
-						channel->frame_count = data_size / 4;
-						
-						// Construct array of samples
-						if (channel->samples) {
-							delete[] channel->samples;
-						}
-						channel->samples = new EngineAudioSample[sample_count]();
-						channel->sample_count = sample_count;
-
-						// Get channel sample rate
-						channel->sample_rate = (float)stream->get_mix_rate();
-
-						// For each sample
-						for (uint32_t i = 0; i < sample_count; i++) {
-							// Get rpm
-							uint32_t rpmi = (uint32_t)(buffer[0]) | ((uint32_t)(buffer[1]) << 16);
-							float rpm;
-							memcpy(&rpm, &rpmi, sizeof(uint32_t));
-
-							// Get start offset
-							int32_t start = (int32_t)(buffer[2]) | ((int32_t)(buffer[3]) << 16);
-
-							// Get end offset
-							int32_t end = (int32_t)(buffer[4]) | ((int32_t)(buffer[5]) << 16);
-
-							// Get the sample
-							EngineAudioSample *sample = &channel->samples[i];
-
-							// Set the variables
-							sample->rpm = rpm;
-							sample->start = start;
-							sample->end = end;
-							sample->sample_rate_ratio = channel->sample_rate / (float)(end - start);
-
-							// Offset the buffer
-							buffer = buffer + 6;
-							start_off += 3;
-						}
-
-						// Skip padding frames
-						buffer = buffer + (padding_frames * 2);
-						start_off += padding_frames;
-
-						// For each frame
-						for (uint32_t i = 0; i < data_size / 4; i++) {
-							// Get the data
-							float l = (int16_t)buffer[0] / (float)(1 << 15);
-							float r = (int16_t)buffer[1] / (float)(1 << 15);
-
-							// Set the frame
-							channel->frames[i] = Vector2(l, r);
-							
-							buffer = buffer + 2;
+						// Header and frames have to fit in the data, the header is laid out
+						// the same whatever the channel count. Counted in 64 bits so large
+						// counts from the file can't wrap around.
+						uint64_t frames_offset = 10 + (uint64_t)sample_count * 6 + (uint64_t)padding_frames * 2;
+						uint32_t frame_count = data_size / (2 * channels);
+
+						if (frames_offset * 2 + (uint64_t)frame_count * 2 * channels <= (uint64_t)data.size()) {
+							// Move buffer
+							buffer = buffer + 10;
+							start_off += 5;
+
+							// Construct array of samples
+							bank->samples = new EngineAudioSample[sample_count]();
+							bank->sample_count = sample_count;
+
+							// Get channel sample rate
+							bank->sample_rate = (float)stream->get_mix_rate();
+
+							bank_valid = true;
+
+							// For each sample
+							for (uint32_t i = 0; i < sample_count; i++) {
+								// Get rpm
+								uint32_t rpmi = (uint32_t)(buffer[0]) | ((uint32_t)(buffer[1]) << 16);
+								float rpm;
+								memcpy(&rpm, &rpmi, sizeof(uint32_t));
+
+								// Get start offset
+								int32_t start = (int32_t)(buffer[2]) | ((int32_t)(buffer[3]) << 16);
+
+								// Get end offset
+								int32_t end = (int32_t)(buffer[4]) | ((int32_t)(buffer[5]) << 16);
+
+								// Frames are read in place, so samples can't point outside of them
+								if (start < 0 || end <= start || (uint32_t)end > frame_count) {
+									bank_valid = false;
+								}
+
+								// Set the sample
+								bank->samples[i].set_range(rpm, start, end, bank->sample_rate);
+
+								// Offset the buffer
+								buffer = buffer + 6;
+								start_off += 3;
+							}
+
+							// Skip padding frames
+							start_off += padding_frames;
+
+							// Keep a reference to the stream's data instead of converting it,
+							// frames get decoded while they're played
+							bank->data = data;
+							bank->data_read = new PoolByteArray::Read(bank->data.read());
+							bank->pcm = (const int16_t *)bank->data_read->ptr() + frames_offset;
+							bank->channels = channels;
+							bank->frame_count = frame_count;
+
+							if (!bank_valid) {
+								WARN_PRINT("Engine audio file sample out of range");
+							}
+						} else {
+							WARN_PRINT("Engine audio file too small");
 						}
-
-						channel_valid = true;
 					} else {
 						WARN_PRINT("Invalid engine audio file version");
 					}
@@ -105,32 +110,27 @@ void EngineAudioPlayer::update_channel(EngineAudioChannel *channel, Ref<AudioStr
 				WARN_PRINT("Engine audio file too small");
 			}
 		} else {
-			WARN_PRINT("Engine audio file only supports 16 bit PCM stereo data");
+			WARN_PRINT("Engine audio file only supports 16 bit PCM data");
 		}
 	}
 
-	if (!channel_valid) {
-		if (channel->frames) delete[] channel->frames;
-		if (channel->samples) delete[] channel->samples;
-		channel->frames = nullptr;
-		channel->samples = nullptr;
-		channel->frame_count = 0;
-		channel->sample_count = 0;
-		channel->sample_rate = 44100;
+	if (!bank_valid) {
+		delete bank;
 		WARN_PRINT("Invalid engine audio file");
-	}	
-	
-	channel->dirty = false;
+		return nullptr;
+	}
+
+	bank->update_rpm_lookup();
 
 	// Godot::print("----------------------------");
 	// Godot::print(
 	// 	"frame_count:{0}\nsample_count:{1}\nsample_rate:{2}", 
-	// 	channel->frame_count, 
-	// 	channel->sample_count, 
-	// 	channel->sample_rate
+	// 	bank->frame_count, 
+	// 	bank->sample_count, 
+	// 	bank->sample_rate
 	// );
-	// for (int i = 0; i < channel->sample_count; i++) {
-	// 	EngineAudioSample *sample = &channel->samples[i];
+	// for (int i = 0; i < bank->sample_count; i++) {
+	// 	EngineAudioSample *sample = &bank->samples[i];
 
 	// 	Godot::print(
 	// 		"rpm:{0}\nstart:{1}\nend:{2}\nsample_rate_ratio:{3}", 
@@ -141,15 +141,153 @@ void EngineAudioPlayer::update_channel(EngineAudioChannel *channel, Ref<AudioStr
 	// 	);
 	// }
 	// Godot::print("----------------------------");
+
+	return bank;
+}
+
+EngineAudioPlayer::EngineAudioBank *EngineAudioPlayer::load_bank_file(String path, int stem) {
+	EngineAudioBank *bank = new EngineAudioBank();
+
+	const uint8_t *file_data = nullptr;
+	size_t file_size = 0;
+	bool check_data = false;
+
+	String global_path = ProjectSettings::get_singleton()->globalize_path(path);
+
+	bank->file = new EngineMappedFile();
+	if (bank->file->open(global_path.utf8().get_data())) {
+		file_data = bank->file->data;
+		file_size = bank->file->size;
+	} else {
+		// Files inside a pack can't be mapped, they are read into memory instead and
+		// the data checksum costs little on top of that
+		delete bank->file;
+		bank->file = nullptr;
+
+		Ref<File> file;
+		file.instance();
+		if (file->open(path, File::READ) == Error::OK) {
+			bank->data = file->get_buffer(file->get_len());
+			file->close();
+
+			bank->data_read = new PoolByteArray::Read(bank->data.read());
+			file_data = bank->data_read->ptr();
+			file_size = (size_t)bank->data.size();
+			check_data = true;
+		}
+	}
+
+	const EngineBankHeader *header = engine_bank_validate(file_data, file_size, check_data);
+	if (!header) {
+		delete bank;
+		WARN_PRINT("Invalid engine bank file");
+		return nullptr;
+	}
+
+	const EngineBankIndexEntry *index = (const EngineBankIndexEntry *)(file_data + header->index_offset);
+
+	if (header->codec == ENGINE_BANK_CODEC_ADPCM) {
+		bank->blocks = file_data + header->stem_offsets[stem];
+		bank->block_frames = header->block_frames;
+		bank->block_size = engine_bank_block_size(header->channels, header->block_frames);
+		while ((1u << bank->block_shift) < bank->block_frames) bank->block_shift++;
+	} else {
+		bank->pcm = (const int16_t *)(file_data + header->stem_offsets[stem]);
+	}
+	bank->channels = header->channels;
+	bank->frame_count = header->frame_count;
+	bank->sample_count = header->sample_count;
+	bank->sample_rate = (float)header->sample_rate;
+
+	bank->samples = new EngineAudioSample[header->sample_count]();
+	for (uint32_t i = 0; i < header->sample_count; i++) {
+		bank->samples[i].set_range(index[i].rpm, index[i].start, index[i].end, bank->sample_rate);
+		bank->samples[i].block = index[i].block;
+	}
+	bank->update_rpm_lookup();
+
+	return bank;
+}
+
+static std::mutex bank_cache_mutex;
+static std::unordered_map<std::string, EngineAudioPlayer::EngineAudioBank *> bank_cache;
+
+// Both need bank_cache_mutex held
+static EngineAudioPlayer::EngineAudioBank *find_cached_bank(const std::string &key) {
+	auto it = bank_cache.find(key);
+	if (it == bank_cache.end()) return nullptr;
+
+	it->second->refcount++;
+	return it->second;
+}
+
+static EngineAudioPlayer::EngineAudioBank *add_cached_bank(const std::string &key, EngineAudioPlayer::EngineAudioBank *bank) {
+	if (!bank) return nullptr;
+
+	bank->key = key;
+	bank->refcount = 1;
+	bank_cache[key] = bank;
+
+	return bank;
+}
+
+EngineAudioPlayer::EngineAudioBank *EngineAudioPlayer::acquire_bank(Ref<AudioStreamSample> stream) {
+	if (!stream.is_valid()) {
+		WARN_PRINT("Invalid engine audio file");
+		return nullptr;
+	}
+
+	std::string key = "stream:" + std::to_string((uint64_t)stream->get_instance_id());
+
+	std::lock_guard<std::mutex> lock(bank_cache_mutex);
+
+	EngineAudioBank *bank = find_cached_bank(key);
+	if (bank) return bank;
+
+	return add_cached_bank(key, load_bank(stream));
+}
+
+EngineAudioPlayer::EngineAudioBank *EngineAudioPlayer::acquire_bank_file(String path, int stem) {
+	String global_path = ProjectSettings::get_singleton()->globalize_path(path);
+	std::string key = "file:" + std::to_string(stem) + ":" + global_path.utf8().get_data();
+
+	std::lock_guard<std::mutex> lock(bank_cache_mutex);
+
+	EngineAudioBank *bank = find_cached_bank(key);
+	if (bank) return bank;
+
+	return add_cached_bank(key, load_bank_file(path, stem));
+}
+
+void EngineAudioPlayer::release_bank(EngineAudioBank *bank) {
+	if (!bank) return;
+
+	std::lock_guard<std::mutex> lock(bank_cache_mutex);
+
+	bank->refcount--;
+	if (bank->refcount == 0) {
+		bank_cache.erase(bank->key);
+		delete bank;
+	}
+}
+
+void EngineAudioPlayer::update_channel(EngineAudioChannel *channel, Ref<AudioStreamSample> stream, int stem) {
+	// Acquired first, so setting the same stream again keeps its bank loaded
+	EngineAudioBank *bank = bank_path.empty() ? acquire_bank(stream) : acquire_bank_file(bank_path, stem);
+	release_bank(channel->bank);
+
+	channel->set_bank(bank);
+	channel->dirty = false;
 }
 
 void EngineAudioPlayer::update_dirty_channels() {
-	if (crankshaft_channel->dirty) update_channel(crankshaft_channel, crankshaft_stream);
-	if (ignition_channel->dirty) update_channel(ignition_channel, ignition_stream);
-	if (exhaust_channel->dirty) update_channel(exhaust_channel, exhaust_stream);
+	if (crankshaft_channel->dirty) update_channel(crankshaft_channel, crankshaft_stream, 0);
+	if (ignition_channel->dirty) update_channel(ignition_channel, ignition_stream, 1);
+	if (exhaust_channel->dirty) update_channel(exhaust_channel, exhaust_stream, 2);
 }
 
 void EngineAudioPlayer::process_audio(float delta) {
+	uint64_t start = engine_stats_now();
 	update_dirty_channels();
 
 	ERR_FAIL_COND(!generator.is_valid());
@@ -165,50 +303,137 @@ void EngineAudioPlayer::process_audio(float delta) {
 
 	ERR_FAIL_COND(!generator_playback->can_push_buffer(frames));
 
-	delta = 1.0f / mix_rate;
-
 	PoolVector2Array buffer;
 	buffer.resize(frames);
 	PoolVector2Array::Write buf = buffer.write();
-	Vector2 *buf_ptr = buf.ptr();
+
+	mix_frames(buf.ptr(), frames, mix_rate);
+
+	generator_playback->push_buffer(buffer);
+
+	stats->add_block(engine_stats_now() - start, frames, (uint32_t)mix_rate, false);
+}
+
+Dictionary EngineAudioPlayer::get_render_stats() const {
+	return EngineAudioMonitors::snapshot_to_dictionary(stats->get_snapshot());
+}
+
+void EngineAudioPlayer::skip_blend() {
+	internal_rpm = rpm;
+	internal_master_volume = master_volume;
+	internal_crankshaft_volume = crankshaft_volume;
+	internal_ignition_volume = ignition_volume;
+	internal_exhaust_volume = exhaust_volume;
+}
+
+float EngineAudioPlayer::get_crank_phase() {
+	update_dirty_channels();
+
+	if (crankshaft_channel->get_sample_count() > 0) return crankshaft_channel->get_phase(internal_rpm);
+	if (ignition_channel->get_sample_count() > 0) return ignition_channel->get_phase(internal_rpm);
+	return exhaust_channel->get_phase(internal_rpm);
+}
+
+void EngineAudioPlayer::set_crank_phase(float p_phase) {
+	update_dirty_channels();
+
+	crankshaft_channel->set_phase(p_phase);
+	ignition_channel->set_phase(p_phase);
+	exhaust_channel->set_phase(p_phase);
+}
+
+// Moves p_value toward p_target by at most p_rate per frame and writes the value of
+// every frame. The ramp is linear up to the frame it reaches the target and holds it
+// from there, a negative rate jumps straight to the target.
+static inline void ramp_block(float &p_value, float p_target, float p_rate, float *p_out, uint32_t p_frames) {
+	if (p_rate == 0) {
+		for (uint32_t i = 0; i < p_frames; i++) {
+			p_out[i] = p_value;
+		}
+		return;
+	}
+
+	float diff = p_target - p_value;
+	uint32_t ramp = 0;
+	if (p_rate > 0) {
+		float len = Math::abs(diff) / p_rate;
+		ramp = len < (float)p_frames ? (uint32_t)len : p_frames;
+	}
+
+	float step = diff > 0 ? p_rate : -p_rate;
+	for (uint32_t i = 0; i < ramp; i++) {
+		p_out[i] = p_value + step * (float)(i + 1);
+	}
+	for (uint32_t i = ramp; i < p_frames; i++) {
+		p_out[i] = p_target;
+	}
+
+	if (p_frames > 0) {
+		p_value = p_out[p_frames - 1];
+	}
+}
+
+void EngineAudioPlayer::mix_frames(Vector2 *p_buffer, uint32_t p_frames, float p_mix_rate) {
+	update_dirty_channels();
+
+	float delta = 1.0f / p_mix_rate;
 
 	float volf = volume_blend >= 0 ? volume_blend * delta : -1;
 	float rpmf = rpm_blend >= 0 ? rpm_blend * delta : -1;
 
 	// crankshaft_channel->print_info(rpm);
 
-	for (uint32_t i = 0; i < frames; i++) {
-		internal_rpm += rpmf >= 0 ? Math::clamp(
-			rpm - internal_rpm, -rpmf, rpmf
-		) : rpm - internal_rpm;
-
-		crankshaft_channel->advance(internal_rpm, delta);
-		ignition_channel->advance(internal_rpm, delta);
-		exhaust_channel->advance(internal_rpm, delta);
-
-		internal_master_volume += volf >= 0 ? Math::clamp(
-			master_volume - internal_master_volume, -volf, volf
-		) : master_volume - internal_master_volume;
-		internal_crankshaft_volume += volf >= 0 ? Math::clamp(
-			crankshaft_volume - internal_crankshaft_volume, -volf, volf
-		) : crankshaft_volume - internal_crankshaft_volume;
-		internal_ignition_volume += volf >= 0 ? Math::clamp(
-			ignition_volume - internal_ignition_volume, -volf, volf
-		) : ignition_volume - internal_ignition_volume;
-		internal_exhaust_volume += volf >= 0 ? Math::clamp(
-			exhaust_volume - internal_exhaust_volume, -volf, volf
-		) : exhaust_volume - internal_exhaust_volume;
-
-		Vector2 crankshaft = crankshaft_channel->get_sample(internal_rpm) * internal_crankshaft_volume;
-		Vector2 ignition = ignition_channel->get_sample(internal_rpm) * internal_ignition_volume;
-		Vector2 exhaust = exhaust_channel->get_sample(internal_rpm) * internal_exhaust_volume;
-
-		Vector2 mixed = (crankshaft + ignition + exhaust) * internal_master_volume;
-
-		buf_ptr[i] = mixed;
-	}
+	float *block_rpm = get_block_rpm();
+	float *master_gain = get_block_gain(0);
+	float *crankshaft_gain = get_block_gain(1);
+	float *ignition_gain = get_block_gain(2);
+	float *exhaust_gain = get_block_gain(3);
+	float *crankshaft_l = get_block_stem(0);
+	float *crankshaft_r = get_block_stem(1);
+	float *ignition_l = get_block_stem(2);
+	float *ignition_r = get_block_stem(3);
+	float *exhaust_l = get_block_stem(4);
+	float *exhaust_r = get_block_stem(5);
+
+	uint32_t frame = 0;
+	while (frame < p_frames) {
+		uint32_t frames = p_frames - frame < PLAYER_BLOCK ? p_frames - frame : PLAYER_BLOCK;
+
+		ramp_block(internal_rpm, rpm, rpmf, block_rpm, frames);
+		ramp_block(internal_master_volume, master_volume, volf, master_gain, frames);
+		ramp_block(internal_crankshaft_volume, crankshaft_volume, volf, crankshaft_gain, frames);
+		ramp_block(internal_ignition_volume, ignition_volume, volf, ignition_gain, frames);
+		ramp_block(internal_exhaust_volume, exhaust_volume, volf, exhaust_gain, frames);
+
+		crankshaft_channel->render(block_rpm, delta, frames, crankshaft_l, crankshaft_r);
+		ignition_channel->render(block_rpm, delta, frames, ignition_l, ignition_r);
+		exhaust_channel->render(block_rpm, delta, frames, exhaust_l, exhaust_r);
+
+		// Mix in place into the crankshaft stem, the tail of the block may be a partial vector
+		for (uint32_t i = 0; i < frames; i += ENGINE_SIMD_LANES) {
+			vfloat master = v_load(master_gain + i);
+			vfloat crankshaft = v_load(crankshaft_gain + i);
+			vfloat ignition = v_load(ignition_gain + i);
+			vfloat exhaust = v_load(exhaust_gain + i);
+
+			vfloat l = v_mul(v_load(crankshaft_l + i), crankshaft);
+			l = v_add(l, v_mul(v_load(ignition_l + i), ignition));
+			l = v_add(l, v_mul(v_load(exhaust_l + i), exhaust));
+			v_store(crankshaft_l + i, v_mul(l, master));
+
+			vfloat r = v_mul(v_load(crankshaft_r + i), crankshaft);
+			r = v_add(r, v_mul(v_load(ignition_r + i), ignition));
+			r = v_add(r, v_mul(v_load(exhaust_r + i), exhaust));
+			v_store(crankshaft_r + i, v_mul(r, master));
+		}
 
-	generator_playback->push_buffer(buffer);
+		Vector2 *out = p_buffer + frame;
+		for (uint32_t i = 0; i < frames; i++) {
+			out[i] = Vector2(crankshaft_l[i], crankshaft_r[i]);
+		}
+
+		frame += frames;
+	}
 }
 
 void EngineAudioPlayer::_init() {}
@@ -219,6 +444,7 @@ EngineAudioPlayer::EngineAudioPlayer() {
 	crankshaft_stream = Ref<AudioStreamSample>();
 	ignition_stream = Ref<AudioStreamSample>();
 	exhaust_stream = Ref<AudioStreamSample>();
+	bank_path = String();
 
 	crankshaft_channel = new EngineAudioChannel();
 	ignition_channel = new EngineAudioChannel();
@@ -238,6 +464,11 @@ EngineAudioPlayer::EngineAudioPlayer() {
 
 	volume_blend = -1;
 	rpm_blend = -1;
+
+	block_data = (float *)aligned_malloc(sizeof(float) * PLAYER_BLOCK * 11);
+	memset(block_data, 0, sizeof(float) * PLAYER_BLOCK * 11);
+
+	stats = new EngineStats(ENGINE_STATS_PLAYER);
 }
 
 EngineAudioPlayer::~EngineAudioPlayer() {
@@ -250,6 +481,10 @@ EngineAudioPlayer::~EngineAudioPlayer() {
 	if (exhaust_channel) {
 		delete exhaust_channel;
 	}
+	if (block_data) {
+		aligned_free(block_data);
+	}
+	delete stats;
 }
 
 void EngineAudioPlayer::_register_methods() {
@@ -283,6 +518,16 @@ void EngineAudioPlayer::_register_methods() {
 		&EngineAudioPlayer::get_exhaust_stream,
 		Ref<AudioStreamSample>()
 	);
+	register_property<EngineAudioPlayer, String>(
+		"bank_path",
+		&EngineAudioPlayer::set_bank_path,
+		&EngineAudioPlayer::get_bank_path,
+		String(),
+		GODOT_METHOD_RPC_MODE_DISABLED,
+		GODOT_PROPERTY_USAGE_DEFAULT,
+		GODOT_PROPERTY_HINT_FILE,
+		"*.engbank"
+	);
 	register_property<EngineAudioPlayer, float>(
 		"rpm",
 		&EngineAudioPlayer::set_rpm,
@@ -327,4 +572,9 @@ void EngineAudioPlayer::_register_methods() {
 	);
 	
 	register_method("process_audio", &EngineAudioPlayer::process_audio);
+	register_method("skip_blend", &EngineAudioPlayer::skip_blend);
+	register_method("get_crank_phase", &EngineAudioPlayer::get_crank_phase);
+	register_method("set_crank_phase", &EngineAudioPlayer::set_crank_phase);
+	register_method("get_render_stats", &EngineAudioPlayer::get_render_stats);
+	register_method("reset_render_stats", &EngineAudioPlayer::reset_render_stats);
 }
\ No newline at end of file
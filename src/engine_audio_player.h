@@ -8,6 +8,16 @@
 #include <AudioStreamSample.hpp>
 #include <AudioStreamGenerator.hpp>
 #include <AudioStreamGeneratorPlayback.hpp>
+#include <Dictionary.hpp>
+#include "engine_utils.h"
+#include "engine_bank_file.h"
+#include "engine_stats.h"
+#include <string>
+
+// Frames mixed per block, smoothing is worked out once per block
+#define PLAYER_BLOCK 64
+// Decoded ADPCM blocks kept per channel, both blended samples may straddle a block
+#define PLAYER_BLOCK_CACHE 4
 
 namespace godot {
 
@@ -24,19 +34,40 @@ public:
 		int start;
 		int end;
 		float sample_rate_ratio;
-		float pos;
+		// Engine cycles in the loop, loops start at crank phase zero
+		float cycles;
+		// Loops played per crank turn of the channel
+		double pos_per_turn;
+		// First ADPCM block of the loop in compressed banks
+		uint32_t block;
+
+		void set_range(float p_rpm, int p_start, int p_end, float p_sample_rate) {
+			rpm = p_rpm;
+			start = p_start;
+			end = p_end;
+			sample_rate_ratio = p_sample_rate / (float)(end - start);
+			cycles = Math::max(Math::floor((end - start) * rpm / (p_sample_rate * 120.0f) + 0.5f), 1.0f);
+			pos_per_turn = (double)sample_rate_ratio * 120.0 / rpm;
+		}
+
+		float get_pos(double crank_turns) const {
+			double p = crank_turns * pos_per_turn;
+			float pos = (float)(p - std::floor(p));
+			return pos < 1.0f ? pos : 0.0f;
+		}
 
-		Vector2 get_sample(Vector2 *frames) {
-			int size = (end - start);
+		// The two frames around pos, relative to start, and the interpolation
+		// factor between them
+		float locate(float pos, uint32_t &i, uint32_t &j) const {
+			uint32_t size = (uint32_t)(end - start);
 			float t = pos * size;
-			uint32_t i = (uint32_t)t;
-			uint32_t j = i + 1;
-			float fract = Math::fmod(t, 1.0f);
+			i = (uint32_t)t;
+			float fract = t - (float)i;
 
-			Vector2 a = frames[start + i % size];
-			Vector2 b = frames[start + j % size];
+			i = i < size ? i : i - size;
+			j = i + 1 < size ? i + 1 : 0;
 
-			return a * (1 - fract) + b * fract;
+			return fract;
 		}
 
 		EngineAudioSample() {
@@ -44,71 +75,323 @@ public:
 			start = 0;
 			end = 1;
 			sample_rate_ratio = 0;
-			pos = 0;
+			cycles = 1;
+			pos_per_turn = 0;
+			block = 0;
 		}
 		~EngineAudioSample() {}
 	};
 
-	class EngineAudioChannel {
+	// A parsed stream or bank file stem, shared by every player using it through
+	// the bank cache. Read only once loaded.
+	class EngineAudioBank {
 	public:
-		Vector2 *frames;
+		std::string key;
+		int refcount;
+
+		// First frame, points into data or file which are kept for as long as the bank
+		const int16_t *pcm;
+		// First ADPCM block instead of pcm in compressed banks
+		const uint8_t *blocks;
+		uint32_t block_frames;
+		uint32_t block_shift;
+		uint32_t block_size;
+		PoolByteArray data;
+		PoolByteArray::Read *data_read;
+		EngineMappedFile *file;
+		// Interleaved channels per frame, 1 or 2
+		int channels;
 		EngineAudioSample *samples;
 		int frame_count;
 		int sample_count;
 		float sample_rate;
-		bool dirty;
 
-		void advance(float rpm, float delta) {
+		// Set when the samples are evenly spaced in rpm, lookups then skip the search
+		float rpm_min;
+		float rpm_inv_step;
+
+		void update_rpm_lookup() {
+			rpm_min = 0;
+			rpm_inv_step = 0;
+			if (sample_count < 3) return;
+
+			float first = samples[0].rpm;
+			float step = (samples[sample_count - 1].rpm - first) / (sample_count - 1);
+			if (!(step > 0)) return;
+
 			for (int i = 0; i < sample_count; i++) {
-				EngineAudioSample *sample = &samples[i];
-				float pitch = rpm / sample->rpm;
+				if (Math::abs(samples[i].rpm - (first + step * i)) > step * 0.01f) return;
+			}
+
+			rpm_min = first;
+			rpm_inv_step = 1.0f / step;
+		}
+
+		EngineAudioBank() {
+			refcount = 0;
+			pcm = nullptr;
+			blocks = nullptr;
+			block_frames = 0;
+			block_shift = 0;
+			block_size = 0;
+			data_read = nullptr;
+			file = nullptr;
+			channels = 2;
+			samples = nullptr;
+			frame_count = 0;
+			sample_count = 0;
+			sample_rate = 44100;
+			rpm_min = 0;
+			rpm_inv_step = 0;
+		}
+		~EngineAudioBank() {
+			if (samples) delete[] samples;
+			if (data_read) delete data_read;
+			if (file) delete file;
+		}
+	};
+
+	class EngineAudioChannel {
+	public:
+		EngineAudioBank *bank;
+		bool dirty;
+
+		// Crank turns played so far, samples work out their position from it when
+		// they get blended instead of all of them advancing every frame
+		double crank_turns;
+		// Bracketing pair of the last lookup, rpm barely moves between frames
+		int last_index;
+
+		// Least recently used blocks get decoded over
+		int16_t *cache_data;
+		uint32_t cache_capacity;
+		uint32_t cache_block[PLAYER_BLOCK_CACHE];
+		uint32_t cache_used[PLAYER_BLOCK_CACHE];
+		uint32_t cache_clock;
+		int cache_last;
+
+		int get_sample_count() const {return bank ? bank->sample_count : 0;}
+
+		void set_bank(EngineAudioBank *p_bank) {
+			bank = p_bank;
+			last_index = 0;
+
+			for (int i = 0; i < PLAYER_BLOCK_CACHE; i++) {
+				cache_block[i] = UINT32_MAX;
+				cache_used[i] = 0;
+			}
+
+			uint32_t capacity = bank && bank->blocks ? PLAYER_BLOCK_CACHE * bank->block_frames * bank->channels : 0;
+			if (capacity > cache_capacity) {
+				if (cache_data) delete[] cache_data;
+				cache_data = new int16_t[capacity];
+				cache_capacity = capacity;
+			}
+		}
+
+		const int16_t *get_block(uint32_t block) {
+			uint32_t stride = bank->block_frames * bank->channels;
+
+			// Consecutive frames nearly always come from the block just used
+			if (cache_block[cache_last] == block) {
+				cache_used[cache_last] = ++cache_clock;
+				return cache_data + cache_last * stride;
+			}
+
+			int oldest = 0;
 
-				sample->pos = fposmod(sample->pos + sample->sample_rate_ratio * delta * pitch, 1.0f);
+			for (int i = 0; i < PLAYER_BLOCK_CACHE; i++) {
+				if (cache_block[i] == block) {
+					cache_used[i] = ++cache_clock;
+					cache_last = i;
+					return cache_data + i * stride;
+				}
+				if (cache_used[i] < cache_used[oldest]) oldest = i;
 			}
+
+			int16_t *decoded = cache_data + oldest * stride;
+			engine_adpcm_decode_block(bank->blocks + (size_t)block * bank->block_size, bank->channels, bank->block_frames, decoded);
+			cache_block[oldest] = block;
+			cache_used[oldest] = ++cache_clock;
+			cache_last = oldest;
+
+			return decoded;
+		}
+
+		const int16_t *get_frame(const EngineAudioSample *sample, uint32_t i) {
+			if (!bank->blocks) return bank->pcm + (sample->start + i) * bank->channels;
+
+			uint32_t block = sample->block + (i >> bank->block_shift);
+			return get_block(block) + (i & (bank->block_frames - 1)) * bank->channels;
+		}
+
+		// Copies the two frames around pos to out and returns the interpolation
+		// factor between them
+		template <int CHANNELS>
+		float gather(const EngineAudioSample *sample, float pos, int16_t *out) {
+			uint32_t i, j;
+			float fract = sample->locate(pos, i, j);
+
+			// Copied one at a time, fetching b may decode over a's block
+			const int16_t *a = get_frame(sample, i);
+			for (int c = 0; c < CHANNELS; c++) out[c] = a[c];
+
+			const int16_t *b = get_frame(sample, j);
+			for (int c = 0; c < CHANNELS; c++) out[CHANNELS + c] = b[c];
+
+			return fract;
+		}
+
+		void advance(float rpm, float delta) {
+			crank_turns += (double)rpm * delta * (1.0 / 120.0);
 		}
 
 		void set_pos(float rpm, float secs) {
-			for (int i = 0; i < sample_count; i++) {
-				EngineAudioSample *sample = &samples[i];
-				float pitch = rpm / sample->rpm;
+			crank_turns = (double)rpm * secs * (1.0 / 120.0);
+		}
+
+		void set_phase(float phase) {
+			crank_turns = fposmod(phase, 1.0f);
+		}
+
+		// Crank phase of the sample closest to rpm, the others follow the same crank
+		float get_phase(float rpm) {
+			if (get_sample_count() == 0) return 0;
 
-				sample->pos = fposmod(sample->sample_rate_ratio * secs * pitch, 1.0f);
+			const EngineAudioSample *samples = bank->samples;
+			int i = find_index(rpm);
+			const EngineAudioSample *closest = &samples[i];
+			if (bank->sample_count > 1 && Math::abs(samples[i + 1].rpm - rpm) < Math::abs(closest->rpm - rpm)) {
+				closest = &samples[i + 1];
 			}
+
+			return fposmod(closest->get_pos(crank_turns) * closest->cycles, 1.0f);
 		}
 
-		Vector2 get_sample(float rpm) {
-			if (sample_count == 0) return Vector2();
+		// First sample of the pair bracketing rpm, samples are sorted by rpm
+		int find_index(float rpm) {
+			int sample_count = get_sample_count();
+			if (sample_count < 2) return 0;
+
+			const EngineAudioSample *samples = bank->samples;
+			int i = last_index;
+			if (i < sample_count - 1 && samples[i].rpm <= rpm && rpm <= samples[i + 1].rpm) return i;
+
+			// Evenly spaced samples, the guess can only be off by one through rounding
+			if (bank->rpm_inv_step > 0) {
+				float f = (rpm - bank->rpm_min) * bank->rpm_inv_step;
+				f = f >= 0 ? f : 0;
+				i = f < sample_count - 2 ? (int)f : sample_count - 2;
+
+				while (i > 0 && samples[i].rpm > rpm) i--;
+				while (i < sample_count - 2 && samples[i + 1].rpm <= rpm) i++;
+				last_index = i;
+
+				return i;
+			}
 
-			if (sample_count == 1) {
-				EngineAudioSample *sample = &samples[0];
-				return sample->get_sample(frames);
+			int lo = 0;
+			int hi = sample_count - 1;
+			while (lo < hi) {
+				int mid = (lo + hi) / 2;
+				if (samples[mid].rpm > rpm) {
+					hi = mid;
+				} else {
+					lo = mid + 1;
+				}
 			}
 
-			for (int i = 0; i < sample_count - 1; i++) {
-				EngineAudioSample *sample0 = &samples[i];
-				EngineAudioSample *sample1 = &samples[i + 1];
+			i = lo - 1;
+			i = i < 0 ? 0 : (i > sample_count - 2 ? sample_count - 2 : i);
+			last_index = i;
+
+			return i;
+		}
 
-				if (i < sample_count - 2 && sample1->rpm < rpm) continue;
-				if (i > 0 && sample0->rpm > rpm) continue;
+		// Planar stereo for a block of at most PLAYER_BLOCK frames, rpm holds the
+		// smoothed rpm of each frame. Only the frames being interpolated get decoded.
+		void render(const float *rpm, float delta, uint32_t frames, float *out_l, float *out_r) {
+			if (get_sample_count() == 0) {
+				for (uint32_t i = 0; i < frames; i++) {
+					advance(rpm[i], delta);
+					out_l[i] = 0;
+					out_r[i] = 0;
+				}
+				return;
+			}
 
-				float st = (rpm - sample0->rpm) / (sample1->rpm - sample0->rpm);
-				st = st < 0 ? 0 : (st > 1 ? 1 : st);
+			if (bank->channels == 1) {
+				render_layout<1>(rpm, delta, frames, out_l, out_r);
+			} else {
+				render_layout<2>(rpm, delta, frames, out_l, out_r);
+			}
+		}
 
-				Vector2 a = sample0->get_sample(frames);
-				Vector2 b = sample1->get_sample(frames);
+		// Mono banks are decoded and interpolated as mono and only upmixed here
+		template <int CHANNELS>
+		void render_layout(const float *rpm, float delta, uint32_t frames, float *out_l, float *out_r) {
+			const EngineAudioSample *samples = bank->samples;
+			int sample_count = bank->sample_count;
+
+			// Per frame, two frames of both bracketing samples
+			const int stride = CHANNELS * 4;
+			int16_t gathered[PLAYER_BLOCK * 8];
+			float decoded[PLAYER_BLOCK * 8];
+			float fract[PLAYER_BLOCK * 2];
+			float blend[PLAYER_BLOCK];
+
+			for (uint32_t i = 0; i < frames; i++) {
+				advance(rpm[i], delta);
+
+				int index = find_index(rpm[i]);
+				const EngineAudioSample *sample0 = &samples[index];
+				const EngineAudioSample *sample1 = sample_count > 1 ? &samples[index + 1] : sample0;
+
+				float st = 0;
+				if (sample1 != sample0) {
+					st = (rpm[i] - sample0->rpm) / (sample1->rpm - sample0->rpm);
+					st = st < 0 ? 0 : (st > 1 ? 1 : st);
+				}
 
-				return a * (1 - st) + b * st;
+				fract[i * 2 + 0] = gather<CHANNELS>(sample0, sample0->get_pos(crank_turns), gathered + i * stride);
+				fract[i * 2 + 1] = gather<CHANNELS>(sample1, sample1->get_pos(crank_turns), gathered + i * stride + CHANNELS * 2);
+				blend[i] = st;
 			}
 
-			return Vector2();
+			// Converts in multiples of 8, the values past the block are never read
+			v_pcm16_to_float(gathered, decoded, (frames * stride + 7) & ~7u);
+
+			for (uint32_t i = 0; i < frames; i++) {
+				const float *d = decoded + i * stride;
+				float f0 = fract[i * 2 + 0];
+				float f1 = fract[i * 2 + 1];
+
+				if (CHANNELS == 1) {
+					float m0 = d[0] + (d[1] - d[0]) * f0;
+					float m1 = d[2] + (d[3] - d[2]) * f1;
+
+					out_l[i] = m0 + (m1 - m0) * blend[i];
+					out_r[i] = out_l[i];
+				} else {
+					float l0 = d[0] + (d[2] - d[0]) * f0;
+					float r0 = d[1] + (d[3] - d[1]) * f0;
+					float l1 = d[4] + (d[6] - d[4]) * f1;
+					float r1 = d[5] + (d[7] - d[5]) * f1;
+
+					out_l[i] = l0 + (l1 - l0) * blend[i];
+					out_r[i] = r0 + (r1 - r0) * blend[i];
+				}
+			}
 		}
 
 		void print_info(float rpm) {
+			int sample_count = get_sample_count();
 			if (sample_count > 1) {
+				const EngineAudioSample *samples = bank->samples;
 				Godot::print("RPM: {0}", rpm);
 				for (int i = 0; i < sample_count - 1; i++) {
-					EngineAudioSample *sample0 = &samples[i];
-					EngineAudioSample *sample1 = &samples[i + 1];
+					const EngineAudioSample *sample0 = &samples[i];
+					const EngineAudioSample *sample1 = &samples[i + 1];
 
 					if (i < sample_count - 2 && sample1->rpm < rpm) continue;
 					if (i > 0 && sample0->rpm > rpm) continue;
@@ -124,16 +407,22 @@ public:
 		}
 		
 		EngineAudioChannel() {
-			frames = nullptr;
-			samples = nullptr;
-			frame_count = 0;
-			sample_count = 0;
-			sample_rate = 44100;
+			bank = nullptr;
 			dirty = true;
+			crank_turns = 0;
+			last_index = 0;
+			cache_data = nullptr;
+			cache_capacity = 0;
+			cache_clock = 0;
+			cache_last = 0;
+			for (int i = 0; i < PLAYER_BLOCK_CACHE; i++) {
+				cache_block[i] = UINT32_MAX;
+				cache_used[i] = 0;
+			}
 		}
 		~EngineAudioChannel() {
-			if (frames) delete[] frames;
-			if (samples) delete[] samples;
+			EngineAudioPlayer::release_bank(bank);
+			if (cache_data) delete[] cache_data;
 		}
 	};
 
@@ -162,7 +451,26 @@ public:
 	float internal_ignition_volume;
 	float internal_exhaust_volume;
 
-	void update_channel(EngineAudioChannel *channel, Ref<AudioStreamSample> stream);
+	// Planar scratch for a block: smoothed rpm, four gains and the three stems in stereo
+	float *block_data;
+	float *get_block_rpm() {return block_data;}
+	float *get_block_gain(int i) {return block_data + PLAYER_BLOCK * (1 + i);}
+	float *get_block_stem(int i) {return block_data + PLAYER_BLOCK * (5 + i);}
+
+	EngineStats *stats;
+
+	// Overrides the streams with the stems of a bank container
+	String bank_path;
+
+	// Banks are cached by stream or by file, a stream's data is treated as fixed once
+	// a player used it
+	static EngineAudioBank *load_bank(Ref<AudioStreamSample> stream);
+	static EngineAudioBank *load_bank_file(String path, int stem);
+	static EngineAudioBank *acquire_bank(Ref<AudioStreamSample> stream);
+	static EngineAudioBank *acquire_bank_file(String path, int stem);
+	static void release_bank(EngineAudioBank *bank);
+
+	void update_channel(EngineAudioChannel *channel, Ref<AudioStreamSample> stream, int stem);
 	void update_dirty_channels();
 public:
 	static void _register_methods();
@@ -195,6 +503,14 @@ public:
 	}
 	Ref<AudioStreamSample> get_exhaust_stream() const {return exhaust_stream;}
 
+	void set_bank_path(String p_path) {
+		bank_path = p_path;
+		crankshaft_channel->dirty = true;
+		ignition_channel->dirty = true;
+		exhaust_channel->dirty = true;
+	}
+	String get_bank_path() const {return bank_path;}
+
 	void set_rpm(float p_volume) {rpm = p_volume;}
 	float get_rpm() const {return rpm;}
 
@@ -216,7 +532,23 @@ public:
 	void set_volume_blend(float p_blend) {volume_blend = p_blend;}
 	float get_volume_blend() const {return volume_blend;}
 
+	bool has_samples() const {
+		return crankshaft_channel->get_sample_count() > 0 || ignition_channel->get_sample_count() > 0 || exhaust_channel->get_sample_count() > 0;
+	}
+
+	// Jumps the blended rpm and volumes to their targets
+	void skip_blend();
+
+	float get_crank_phase();
+	void set_crank_phase(float p_phase);
+
+	void mix_frames(Vector2 *p_buffer, uint32_t p_frames, float p_mix_rate);
 	void process_audio(float delta);
+
+	// Timing of process_audio, including bank loads it triggers
+	Dictionary get_render_stats() const;
+	void reset_render_stats() {stats->reset();}
+
 	void _init();
 
 	EngineAudioPlayer();
@@ -1,8 +1,12 @@
 #include "engine_audio_recorder.h"
 #include <GodotGlobal.hpp>
 #include <PoolArrays.hpp>
+#include <File.hpp>
 #include <iostream>
 
+#define RECORDER_CHUNK_FRAMES 4096
+#define WAV_HEADER_SIZE 44
+
 using namespace godot;
 
 template <typename T>
@@ -29,51 +33,52 @@ static inline void v32_to_u16(T val, uint16_t &b0, uint16_t &b1) {
 	b1 = val_ptr[1];
 }
 
-static inline void set_buffer_samples_crossfaded(
-	float *p_audio_frames, uint16_t *p_buffer,
-	int p_num_frames, int p_num_channels,
-	int p_fade_frames
-) {
-	int fade_start = p_num_frames - p_fade_frames;
-	for (int i = 0; i < p_num_frames - p_fade_frames; i++) {
-		for (int j = 0; j < p_num_channels; j++) {
-			float frame = p_audio_frames[i * p_num_channels + j];
-
-			if (i < p_fade_frames) {
-				float fade = i / (float)p_fade_frames;
-				float fade_frame = p_audio_frames[(fade_start + i) * p_num_channels + j];
-				frame = frame * fade + fade_frame * (1 - fade);
-			}
+static inline uint16_t to_pcm16(float p_frame) {
+	p_frame = Math::clamp(p_frame, -1.0f, 1.0f);
+	int framei = (int)(p_frame * 32768);
+	framei = framei < -32768 ? -32768 : (framei > 32767 ? 32767 : framei);
 
-			frame = Math::clamp(frame, -1.0f, 1.0f);
-			int framei = (int)(frame * 32768);
-			framei = framei < -32768 ? -32768 : (framei > 32767 ? 32767 : framei);
+	return (uint16_t)framei;
+}
 
-			p_buffer[i * p_num_channels + j] = (uint16_t)framei;
-		}
+static inline void store_tag(Ref<File> p_file, const char *p_tag) {
+	for (int i = 0; i < 4; i++) {
+		p_file->store_8((uint8_t)p_tag[i]);
 	}
 }
 
-void EngineAudioRecorder::record() {
-	ERR_FAIL_COND(!engine_config.is_valid());
-	ERR_FAIL_COND(!engine_config->is_engine_valid());
-
-	Ref<EngineConfig> config_duplicate = engine_config->duplicate();
-
-	ERR_FAIL_COND(!config_duplicate.is_valid());
-	ERR_FAIL_COND(!config_duplicate->is_engine_valid());
-
+// Where one rpm point lands in the exported buffer
+struct EngineAudioRecorder::Point {
+	float rpm;
+	int frames;
+	int fade_frames;
+	int preheat_frames;
+	int buffer_off;
+};
+
+// Renders one rpm point chunk by chunk. The fade frames rendered before the loop are
+// held back and crossfaded into its end, so every point comes out in order
+struct RecorderSlot {
+	Ref<EngineConfig> config;
+	int point;
+	int rendered;
+
+	// Crankshaft, ignition, exhaust
+	std::vector<float> frames[3];
+	std::vector<float> head[3];
+	std::vector<uint16_t> pcm[3];
+	int out_pos;
+	int out_count;
+
+	RecorderSlot() {point = -1; rendered = 0; out_pos = 0; out_count = 0;}
+};
+
+int EngineAudioRecorder::layout_points(std::vector<Point> &p_points) const {
 	const float min_secs = 1.0f / 120.0f;
 
-	uint32_t sample_rate = config_duplicate->get_sample_rate();
-	
-	config_duplicate->clear_buffer();
+	uint32_t sample_rate = engine_config->get_sample_rate();
 
-	std::vector<float> crankshaft_frames;
-	std::vector<float> ignition_frames;
-	std::vector<float> exhaust_frames;
-	int frame_off = 0;
-	int total_frames = 0;
+	p_points.resize(sample_count > 0 ? sample_count : 0);
 	int buffer_frames = 0;
 
 	for (int i = 0; i < sample_count; i++) {
@@ -81,27 +86,42 @@ void EngineAudioRecorder::record() {
 		float rpm = min_rpm + (top_rpm - min_rpm) * splf;
 		float rps = rpm * min_secs;
 		int cycles = (int)Math::max(duration_per_sample * rps, 1.0f);
-		int frames = (int)Math::max((cycles / rps) * sample_rate, 1.0f);
 		int preheat_cycles = (int)Math::max(preheat_time * rps, 1.0f);
-		int preheat_frames = (int)Math::max((preheat_cycles / rps) * sample_rate, 1.0f);
 		int fade_cycles = (int)(fade_time * rps);
-		int fade_frames = (int)((fade_cycles / rps) * sample_rate);
-		//int off = total_frames;
-		total_frames += frames + fade_frames + padding_frames;
-		buffer_frames += frames + padding_frames;
-
-		crankshaft_frames.resize(total_frames * 2);
-		ignition_frames.resize(total_frames * 2);
-		exhaust_frames.resize(total_frames * 2);
-
-		config_duplicate->set_rpm(rpm);
-		if (i == 0) config_duplicate->skip_frames(preheat_frames);
-		config_duplicate->fill_channel_buffers(
-			&ignition_frames[frame_off * 2], &crankshaft_frames[frame_off * 2], &exhaust_frames[frame_off * 2],
-			frames + fade_frames, 2
-		);
-		frame_off = total_frames;
+
+		Point &point = p_points[i];
+		point.rpm = rpm;
+		point.frames = (int)Math::max((cycles / rps) * sample_rate, 1.0f);
+		point.fade_frames = Math::min((int)((fade_cycles / rps) * sample_rate), point.frames);
+		point.preheat_frames = (int)Math::max((preheat_cycles / rps) * sample_rate, 1.0f);
+		point.buffer_off = buffer_frames;
+
+		buffer_frames += point.frames + padding_frames;
+	}
+
+	return buffer_frames;
+}
+
+int EngineAudioRecorder::get_data_size() const {
+	std::vector<Point> points;
+	int data_size = layout_points(points) * 2 * get_channel_count();
+
+	// Include header data size
+	if (include_audio_header) {
+		data_size += 5 * 4 + sample_count * 3 * 4 + padding_frames * 4;
 	}
+
+	return data_size;
+}
+
+bool EngineAudioRecorder::render_stems(const StemWriter &p_write, bool p_header) {
+	ERR_FAIL_COND_V(!engine_config.is_valid(), false);
+	ERR_FAIL_COND_V(!engine_config->is_engine_valid(), false);
+
+	std::vector<Point> points;
+	int buffer_frames = layout_points(points);
+	int channels = get_channel_count();
+
 	/*
 	Header:
 		1 - Engine audio file identifier (single frame with values L: 0x5555 R: 0xAAAA)
@@ -116,139 +136,223 @@ void EngineAudioRecorder::record() {
 				3 - End offset
 			Rest - audio data
 	*/
+	std::vector<uint16_t> header;
 
-	// Data size
-	int data_size = buffer_frames * 4;
-
-	// Include header data size
-	if (include_audio_header) {
-		data_size += 5 * 4 + sample_count * 3 * 4 + padding_frames * 4;
-	}
-
-	PoolByteArray crankshaft_data;
-	PoolByteArray ignition_data;
-	PoolByteArray exhaust_data;
-	crankshaft_data.resize(data_size);
-	ignition_data.resize(data_size);
-	exhaust_data.resize(data_size);
-	PoolByteArray::Write crankshaft_data_write = crankshaft_data.write();
-	PoolByteArray::Write ignition_data_write = ignition_data.write();
-	PoolByteArray::Write exhaust_data_write = exhaust_data.write();
-	uint16_t *crankshaft_buffer = (uint16_t *)crankshaft_data_write.ptr();
-	uint16_t *ignition_buffer = (uint16_t *)ignition_data_write.ptr();
-	uint16_t *exhaust_buffer = (uint16_t *)exhaust_data_write.ptr();
-
-	int off = 0;
-
-	// Include header data size
-	if (include_audio_header) {
-		#define SET_BUFFER(i, data) {		\
-			crankshaft_buffer[i] = data; 	\
-			ignition_buffer[i] = data; 		\
-			exhaust_buffer[i] = data; 		\
-		}
-
-		#define SKIP_BUFFER(i) {			\
-			crankshaft_buffer += i;			\
-			ignition_buffer += i;			\
-			exhaust_buffer += i;			\
-		}
+	if (p_header && include_audio_header) {
+		header.resize((5 + sample_count * 3 + padding_frames) * 2);
+		uint16_t *buffer = header.data();
 
 		// Engine audio file identifier
-		SET_BUFFER(0, 0x5555);
-		SET_BUFFER(1, 0xAAAA);
+		buffer[0] = 0x5555;
+		buffer[1] = 0xAAAA;
 
 		// Engine audio version
-		SET_BUFFER(2, 0x0000);
-		SET_BUFFER(3, 0x0000);
+		buffer[2] = 0x0000;
+		buffer[3] = 0x0000;
 
 		// Data size
-		SET_BUFFER(4, (uint16_t)(buffer_frames * 4));
-		SET_BUFFER(5, (uint16_t)((buffer_frames * 4) >> 16));
+		buffer[4] = (uint16_t)(buffer_frames * 2 * channels);
+		buffer[5] = (uint16_t)((buffer_frames * 2 * channels) >> 16);
 
 		// Number of samples
-		SET_BUFFER(6, (uint16_t)(sample_count));
-		SET_BUFFER(7, (uint16_t)(sample_count >> 16));
+		buffer[6] = (uint16_t)(sample_count);
+		buffer[7] = (uint16_t)(sample_count >> 16);
 
 		// Padding
-		SET_BUFFER(8, (uint16_t)(padding_frames));
-		SET_BUFFER(9, (uint16_t)(padding_frames >> 19));
+		buffer[8] = (uint16_t)(padding_frames);
+		buffer[9] = (uint16_t)(padding_frames >> 19);
 
-		SKIP_BUFFER(10);
-		int sample_off = 0;
-		int total_sample_frames = 0;
+		buffer += 10;
 
 		// For each sample
 		for (int i = 0; i < sample_count; i++) {
-			float splf = i / (sample_count > 1 ? sample_count - 1.0f : 1.0f);
-			float rpm = min_rpm + (top_rpm - min_rpm) * splf;
-			float rps = rpm * min_secs;
-			int cycles = (int)Math::max(duration_per_sample * rps, 1.0f);
-			int frames = (int)Math::max((cycles / rps) * sample_rate, 1.0f);
-			total_sample_frames += frames + padding_frames;
+			const Point &point = points[i];
+			int sample_off = point.buffer_off;
 
 			// Reinterpret rpm float bits as integer
 			int32_t rpmi;
-			memcpy(&rpmi, &rpm, sizeof(float));
+			memcpy(&rpmi, &point.rpm, sizeof(float));
 
 			// Add rpm
-			SET_BUFFER(0, (uint16_t)(rpmi));
-			SET_BUFFER(1, (uint16_t)(rpmi >> 16));
+			buffer[0] = (uint16_t)(rpmi);
+			buffer[1] = (uint16_t)(rpmi >> 16);
 
 			// Add start offset
-			SET_BUFFER(2, (uint16_t)(sample_off));
-			SET_BUFFER(3, (uint16_t)(sample_off >> 16));
+			buffer[2] = (uint16_t)(sample_off);
+			buffer[3] = (uint16_t)(sample_off >> 16);
 
 			// Add end offset
-			SET_BUFFER(4, (uint16_t)((sample_off + frames)));
-			SET_BUFFER(5, (uint16_t)((sample_off + frames) >> 16));
+			buffer[4] = (uint16_t)((sample_off + point.frames));
+			buffer[5] = (uint16_t)((sample_off + point.frames) >> 16);
 
-			SKIP_BUFFER(6);
+			buffer += 6;
+		}
 
-			sample_off = total_sample_frames;
+		// The padding frames are left zeroed
+	}
+
+	// The header is laid out the same whatever the channel count
+	int header_size = (int)header.size();
+	for (int stem = 0; stem < 3; stem++) {
+		p_write(stem, 0, header.data(), header_size);
+	}
+
+	if (!pool) {
+		pool = new EngineThreadPool();
+	}
+	pool->resize((uint32_t)thread_count);
+
+	// Every point renders on its own engine so the export does not depend on which
+	// thread picks which point up
+	std::vector<RecorderSlot> slots(Math::min((size_t)pool->get_thread_count(), points.size()));
+	std::vector<RecorderSlot *> active;
+	std::vector<uint16_t> silence(padding_frames * channels, 0);
+	float sample_rate = (float)engine_config->get_sample_rate();
+	int next_point = 0;
+
+	while (true) {
+		active.clear();
+
+		for (size_t i = 0; i < slots.size(); i++) {
+			RecorderSlot &slot = slots[i];
+
+			// Engines are built here, duplicating the config goes through Godot which
+			// is not safe from the pool threads. The pool threads only use the synth.
+			if (slot.point < 0 && next_point < sample_count) {
+				slot.config = engine_config->duplicate();
+
+				ERR_FAIL_COND_V(!slot.config.is_valid(), false);
+				slot.config->clear_buffer();
+				ERR_FAIL_COND_V(!slot.config->is_engine_valid(), false);
+
+				slot.config->set_rpm(points[next_point].rpm);
+				slot.point = next_point++;
+				slot.rendered = 0;
+			}
+
+			if (slot.point >= 0) {
+				active.push_back(&slot);
+			}
 		}
 
-		// Add padding
-		for (int i = 0; i < padding_frames; i++) {
-			SET_BUFFER(0, 0);
-			SET_BUFFER(1, 0);
-			SKIP_BUFFER(2);
+		if (active.empty()) {
+			break;
 		}
 
-		#undef SKIP_BUFFER
-		#undef SET_BUFFER
+		pool->run((uint32_t)active.size(), [&](uint32_t i) {
+			RecorderSlot &slot = *active[i];
+			const Point &point = points[slot.point];
+			EngineSynth *synth = slot.config->get_synth();
+
+			if (slot.rendered == 0) {
+				synth->skip_frames(point.preheat_frames);
+				// Every loop starts at crank phase zero, players use this to line up with the model.
+				// The fade frames come first and end right where the loop starts.
+				synth->set_crank_phase(-point.fade_frames * (point.rpm / (sample_rate * 120.f)));
+
+				for (int stem = 0; stem < 3; stem++) {
+					slot.frames[stem].resize(RECORDER_CHUNK_FRAMES * channels);
+					slot.head[stem].resize(point.fade_frames * channels);
+					slot.pcm[stem].resize(RECORDER_CHUNK_FRAMES * channels);
+				}
+			}
+
+			// Chunks never straddle the end of the fade or of the loop
+			int start = slot.rendered;
+			int end = start < point.fade_frames ? point.fade_frames : (start < point.frames ? point.frames : point.frames + point.fade_frames);
+			int count = Math::min(end - start, RECORDER_CHUNK_FRAMES);
+
+			synth->fill_channel_buffers(
+				slot.frames[1].data(), slot.frames[0].data(), slot.frames[2].data(),
+				count, channels
+			);
+			slot.rendered += count;
+
+			for (int stem = 0; stem < 3; stem++) {
+				const float *frames = slot.frames[stem].data();
+				uint16_t *pcm = slot.pcm[stem].data();
+
+				if (start < point.fade_frames) {
+					memcpy(&slot.head[stem][start * channels], frames, count * channels * sizeof(float));
+				} else if (start < point.frames) {
+					for (int j = 0; j < count * channels; j++) {
+						pcm[j] = to_pcm16(frames[j]);
+					}
+				} else {
+					int pos = start - point.frames;
+					const float *head = &slot.head[stem][pos * channels];
+
+					for (int j = 0; j < count; j++) {
+						float fade = (pos + j) / (float)point.fade_frames;
+						for (int c = 0; c < channels; c++) {
+							int k = j * channels + c;
+							pcm[k] = to_pcm16(head[k] * fade + frames[k] * (1 - fade));
+						}
+					}
+				}
+			}
+
+			if (start < point.fade_frames) {
+				slot.out_count = 0;
+			} else {
+				slot.out_pos = start - point.fade_frames;
+				slot.out_count = count;
+			}
+		});
+
+		for (size_t i = 0; i < active.size(); i++) {
+			RecorderSlot &slot = *active[i];
+			const Point &point = points[slot.point];
+			int buffer_off = header_size + point.buffer_off * channels;
+
+			if (slot.out_count > 0) {
+				for (int stem = 0; stem < 3; stem++) {
+					p_write(stem, buffer_off + slot.out_pos * channels, slot.pcm[stem].data(), slot.out_count * channels);
+				}
+			}
+
+			if (slot.rendered == point.frames + point.fade_frames) {
+				for (int stem = 0; stem < 3; stem++) {
+					p_write(stem, buffer_off + point.frames * channels, silence.data(), padding_frames * channels);
+				}
+
+				slot.config.unref();
+				slot.point = -1;
+			}
+		}
 	}
 
-	int buffer_off = 0;
-	frame_off = 0;
+	return true;
+}
+
+void EngineAudioRecorder::record() {
+	ERR_FAIL_COND(!engine_config.is_valid());
 
-	for (int i = 0; i < sample_count; i++) {
-		float splf = i / (sample_count > 1 ? sample_count - 1.0f : 1.0f);
-		float rpm = min_rpm + (top_rpm - min_rpm) * splf;
-		float rps = rpm * min_secs;
-		int cycles = (int)Math::max(duration_per_sample * rps, 1.0f);
-		int frames = (int)Math::max((cycles / rps) * sample_rate, 1.0f);
-		int fade_cycles = (int)(fade_time * rps);
-		int fade_frames = (int)((fade_cycles / rps) * sample_rate);
-
-		Godot::print("{0}", fade_frames);
-
-		set_buffer_samples_crossfaded(
-			&crankshaft_frames[frame_off * 2], &crankshaft_buffer[buffer_off * 2], 
-			frames + fade_frames, 2, fade_frames
-		);
-		set_buffer_samples_crossfaded(
-			&ignition_frames[frame_off * 2], &ignition_buffer[buffer_off * 2], 
-			frames + fade_frames, 2, fade_frames
-		);
-		set_buffer_samples_crossfaded(
-			&exhaust_frames[frame_off * 2], &exhaust_buffer[buffer_off * 2], 
-			frames + fade_frames, 2, fade_frames
-		);
-
-		frame_off += frames + fade_frames + padding_frames;
-		buffer_off += frames + padding_frames;
+	int data_size = get_data_size();
+
+	PoolByteArray crankshaft_data;
+	PoolByteArray ignition_data;
+	PoolByteArray exhaust_data;
+	crankshaft_data.resize(data_size);
+	ignition_data.resize(data_size);
+	exhaust_data.resize(data_size);
+
+	bool recorded;
+	{
+		PoolByteArray::Write crankshaft_data_write = crankshaft_data.write();
+		PoolByteArray::Write ignition_data_write = ignition_data.write();
+		PoolByteArray::Write exhaust_data_write = exhaust_data.write();
+		uint16_t *buffers[3] = {
+			(uint16_t *)crankshaft_data_write.ptr(),
+			(uint16_t *)ignition_data_write.ptr(),
+			(uint16_t *)exhaust_data_write.ptr()
+		};
+
+		recorded = render_stems([&](int p_stem, int p_offset, const uint16_t *p_pcm, int p_count) {
+			memcpy(&buffers[p_stem][p_offset], p_pcm, p_count * sizeof(uint16_t));
+		});
 	}
+	ERR_FAIL_COND(!recorded);
 
 	crankshaft_recording.instance();
 	ignition_recording.instance();
@@ -258,19 +362,239 @@ void EngineAudioRecorder::record() {
 	ignition_recording->set_format(AudioStreamSample::FORMAT_16_BITS);
 	exhaust_recording->set_format(AudioStreamSample::FORMAT_16_BITS);
 
-	crankshaft_recording->set_mix_rate((int)sample_rate);
-	ignition_recording->set_mix_rate((int)sample_rate);
-	exhaust_recording->set_mix_rate((int)sample_rate);
+	crankshaft_recording->set_mix_rate((int)engine_config->get_sample_rate());
+	ignition_recording->set_mix_rate((int)engine_config->get_sample_rate());
+	exhaust_recording->set_mix_rate((int)engine_config->get_sample_rate());
 
-	crankshaft_recording->set_stereo(true);
-	ignition_recording->set_stereo(true);
-	exhaust_recording->set_stereo(true);
+	crankshaft_recording->set_stereo(stereo);
+	ignition_recording->set_stereo(stereo);
+	exhaust_recording->set_stereo(stereo);
 
 	crankshaft_recording->set_data(crankshaft_data);
 	ignition_recording->set_data(ignition_data);
 	exhaust_recording->set_data(exhaust_data);
 }
 
+Error EngineAudioRecorder::record_to_files(String p_crankshaft_path, String p_ignition_path, String p_exhaust_path) {
+	ERR_FAIL_COND_V(!engine_config.is_valid(), ERR_UNCONFIGURED);
+
+	String paths[3] = {p_crankshaft_path, p_ignition_path, p_exhaust_path};
+	Ref<File> files[3];
+
+	uint32_t sample_rate = engine_config->get_sample_rate();
+	uint32_t channels = (uint32_t)get_channel_count();
+	int data_size = get_data_size();
+
+	for (int stem = 0; stem < 3; stem++) {
+		files[stem].instance();
+		Error err = files[stem]->open(paths[stem], File::WRITE);
+		ERR_FAIL_COND_V(err != Error::OK, err);
+
+		// 16 bit PCM wave header
+		Ref<File> file = files[stem];
+		store_tag(file, "RIFF");
+		file->store_32(36 + data_size);
+		store_tag(file, "WAVE");
+		store_tag(file, "fmt ");
+		file->store_32(16);
+		file->store_16(1);
+		file->store_16(channels);
+		file->store_32(sample_rate);
+		file->store_32(sample_rate * 2 * channels);
+		file->store_16(2 * channels);
+		file->store_16(16);
+		store_tag(file, "data");
+		file->store_32(data_size);
+	}
+
+	// Chunks arrive out of order, every write seeks to its own place
+	PoolByteArray chunk;
+	bool recorded = render_stems([&](int p_stem, int p_offset, const uint16_t *p_pcm, int p_count) {
+		if (p_count <= 0) {
+			return;
+		}
+
+		chunk.resize(p_count * sizeof(uint16_t));
+		memcpy(chunk.write().ptr(), p_pcm, p_count * sizeof(uint16_t));
+
+		files[p_stem]->seek(WAV_HEADER_SIZE + (int64_t)p_offset * sizeof(uint16_t));
+		files[p_stem]->store_buffer(chunk);
+	});
+
+	for (int stem = 0; stem < 3; stem++) {
+		files[stem]->close();
+	}
+	ERR_FAIL_COND_V(!recorded, FAILED);
+
+	return Error::OK;
+}
+
+Error EngineAudioRecorder::record_to_bank(String p_path) {
+	ERR_FAIL_COND_V(!engine_config.is_valid(), ERR_UNCONFIGURED);
+
+	std::vector<Point> points;
+	int buffer_frames = layout_points(points);
+
+	int channels = get_channel_count();
+	bool adpcm = bank_codec == ENGINE_BANK_CODEC_ADPCM;
+	uint32_t block_frames = adpcm ? ENGINE_BANK_ADPCM_BLOCK_FRAMES : 0;
+	uint32_t block_count = 0;
+
+	std::vector<EngineBankIndexEntry> index(points.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		index[i].rpm = points[i].rpm;
+		index[i].start = points[i].buffer_off;
+		index[i].end = points[i].buffer_off + points[i].frames;
+		index[i].block = block_count;
+
+		// Samples start on a block of their own, padding frames aren't stored
+		if (adpcm) {
+			block_count += (points[i].frames + block_frames - 1) / block_frames;
+		}
+	}
+
+	EngineBankHeader header;
+	engine_bank_init_header(
+		header, engine_config->get_sample_rate(), channels, sample_count, buffer_frames,
+		bank_codec, block_frames, block_count
+	);
+
+	Ref<File> file;
+	file.instance();
+	Error err = file->open(p_path, File::WRITE_READ);
+	ERR_FAIL_COND_V(err != Error::OK, err);
+
+	PoolByteArray chunk;
+	uint64_t stem_size = engine_bank_stem_size(header);
+
+	// Header gets written again once the checksums are known, the alignment gaps are zeroed
+	chunk.resize((int)header.stem_offsets[0]);
+	{
+		PoolByteArray::Write chunk_write = chunk.write();
+		memset(chunk_write.ptr(), 0, chunk.size());
+		memcpy(chunk_write.ptr() + header.index_offset, index.data(), index.size() * sizeof(EngineBankIndexEntry));
+	}
+	file->store_buffer(chunk);
+
+	for (int stem = 0; stem < ENGINE_BANK_STEMS; stem++) {
+		uint64_t stem_end = header.stem_offsets[stem] + stem_size;
+		uint64_t next = stem < ENGINE_BANK_STEMS - 1 ? header.stem_offsets[stem + 1] : stem_end;
+		if (next > stem_end) {
+			chunk.resize((int)(next - stem_end));
+			memset(chunk.write().ptr(), 0, chunk.size());
+			file->seek(stem_end);
+			file->store_buffer(chunk);
+		}
+	}
+
+	// Every sample arrives in order, each ADPCM block is encoded as soon as it fills up.
+	// Only the blocks being filled are held, one per pool thread and stem.
+	uint32_t block_size = adpcm ? engine_bank_block_size(channels, block_frames) : 0;
+	std::vector<std::vector<int16_t>> pending(points.size() * ENGINE_BANK_STEMS);
+	std::vector<int> pending_count(points.size() * ENGINE_BANK_STEMS, 0);
+	std::vector<uint8_t> step_indices(points.size() * ENGINE_BANK_STEMS * 2, 0);
+
+	// Stems are written without the in-band header, offsets count from the stem's first frame
+	bool recorded = render_stems([&](int p_stem, int p_offset, const uint16_t *p_pcm, int p_count) {
+		if (p_count <= 0) {
+			return;
+		}
+
+		if (!adpcm) {
+			chunk.resize(p_count * sizeof(uint16_t));
+			memcpy(chunk.write().ptr(), p_pcm, p_count * sizeof(uint16_t));
+
+			file->seek(header.stem_offsets[p_stem] + (int64_t)p_offset * sizeof(uint16_t));
+			file->store_buffer(chunk);
+			return;
+		}
+
+		// Chunks never straddle a sample, find the one this belongs to
+		int frame = p_offset / channels;
+		int point = 0;
+		for (int lo = 0, hi = (int)points.size() - 1; lo <= hi;) {
+			int mid = (lo + hi) / 2;
+			if (points[mid].buffer_off <= frame) {
+				point = mid;
+				lo = mid + 1;
+			} else {
+				hi = mid - 1;
+			}
+		}
+
+		const Point &sample = points[point];
+		if (frame >= sample.buffer_off + sample.frames) {
+			return;
+		}
+
+		int slot = point * ENGINE_BANK_STEMS + p_stem;
+		std::vector<int16_t> &frames = pending[slot];
+		int &received = pending_count[slot];
+		uint8_t *step_index = &step_indices[slot * 2];
+
+		int pos = frame - sample.buffer_off;
+		ERR_FAIL_COND(pos != received);
+
+		frames.resize(block_frames * channels);
+		const uint16_t *pcm = p_pcm;
+		int count = p_count / channels;
+
+		while (count > 0) {
+			uint32_t block = (uint32_t)received / block_frames;
+			int filled = received - (int)(block * block_frames);
+			int copy = Math::min(count, (int)block_frames - filled);
+
+			memcpy(&frames[filled * channels], pcm, copy * channels * sizeof(uint16_t));
+			received += copy;
+			pcm += copy * channels;
+			count -= copy;
+
+			if (filled + copy < (int)block_frames && received < sample.frames) {
+				break;
+			}
+
+			chunk.resize(block_size);
+			engine_adpcm_encode_block(frames.data(), filled + copy, channels, block_frames, step_index, chunk.write().ptr());
+
+			file->seek(header.stem_offsets[p_stem] + (int64_t)(index[point].block + block) * block_size);
+			file->store_buffer(chunk);
+		}
+
+		if (received == sample.frames) {
+			std::vector<int16_t>().swap(frames);
+		}
+	}, false);
+
+	if (!recorded) {
+		file->close();
+		ERR_FAIL_V(FAILED);
+	}
+
+	// Chunks arrived out of order, the data checksum is worked out from the file
+	uint32_t hash = engine_bank_checksum(nullptr, 0);
+	for (int stem = 0; stem < ENGINE_BANK_STEMS; stem++) {
+		file->seek(header.stem_offsets[stem]);
+		for (uint64_t read = 0; read < stem_size; read += RECORDER_CHUNK_FRAMES * 4) {
+			int64_t count = (int64_t)Math::min(stem_size - read, (uint64_t)RECORDER_CHUNK_FRAMES * 4);
+			PoolByteArray data = file->get_buffer(count);
+			ERR_FAIL_COND_V(data.size() != count, ERR_FILE_CORRUPT);
+
+			hash = engine_bank_checksum(data.read().ptr(), data.size(), hash);
+		}
+	}
+
+	header.data_checksum = hash;
+	header.header_checksum = engine_bank_header_checksum(header, index.data());
+
+	chunk.resize(sizeof(EngineBankHeader));
+	memcpy(chunk.write().ptr(), &header, sizeof(EngineBankHeader));
+	file->seek(0);
+	file->store_buffer(chunk);
+	file->close();
+
+	return Error::OK;
+}
+
 void EngineAudioRecorder::_init() {
 	engine_config = Ref<EngineConfig>();
 	crankshaft_recording = Ref<AudioStreamSample>();
@@ -284,6 +608,9 @@ void EngineAudioRecorder::_init() {
 	sample_count = 32;
 	padding_frames = 8;
 	include_audio_header = true;
+	stereo = false;
+	bank_codec = ENGINE_BANK_CODEC_PCM16;
+	thread_count = 0;
 }
 
 void EngineAudioRecorder::_register_methods() {
@@ -341,18 +668,45 @@ void EngineAudioRecorder::_register_methods() {
 		&EngineAudioRecorder::get_include_audio_header,
 		true
 	);
+	register_property<EngineAudioRecorder, bool>(
+		"stereo", 
+		&EngineAudioRecorder::set_stereo,
+		&EngineAudioRecorder::get_stereo,
+		false
+	);
+	register_property<EngineAudioRecorder, int>(
+		"bank_codec", 
+		&EngineAudioRecorder::set_bank_codec,
+		&EngineAudioRecorder::get_bank_codec,
+		ENGINE_BANK_CODEC_PCM16,
+		GODOT_METHOD_RPC_MODE_DISABLED,
+		GODOT_PROPERTY_USAGE_DEFAULT,
+		GODOT_PROPERTY_HINT_ENUM,
+		"PCM16,IMA-ADPCM"
+	);
+	register_property<EngineAudioRecorder, int>(
+		"thread_count", 
+		&EngineAudioRecorder::set_thread_count,
+		&EngineAudioRecorder::get_thread_count,
+		0
+	);
 	
 	register_method("record", &EngineAudioRecorder::record);
+	register_method("record_to_files", &EngineAudioRecorder::record_to_files);
+	register_method("record_to_bank", &EngineAudioRecorder::record_to_bank);
 	register_method("get_crankshaft_recording", &EngineAudioRecorder::get_crankshaft_recording);
 	register_method("get_ignition_recording", &EngineAudioRecorder::get_ignition_recording);
 	register_method("get_exhaust_recording", &EngineAudioRecorder::get_exhaust_recording);
 }
 
 EngineAudioRecorder::EngineAudioRecorder() {
-	
+	this->thread_count = 0;
+	this->pool = nullptr;
 }
 
 EngineAudioRecorder::~EngineAudioRecorder() {
-	
+	if (this->pool) {
+		delete this->pool;
+	}
 }
 
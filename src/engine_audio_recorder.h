@@ -6,7 +6,12 @@
 #include <Dictionary.hpp>
 #include <Ref.hpp>
 #include <AudioStreamSample.hpp>
+#include <String.hpp>
+#include <vector>
+#include <functional>
 #include "engine_config.h"
+#include "engine_thread_pool.h"
+#include "engine_bank_file.h"
 
 namespace godot {
 
@@ -26,6 +31,20 @@ private:
 	int sample_count;
 	int padding_frames;
 	bool include_audio_header;
+	bool stereo;
+	int bank_codec;
+	int thread_count;
+
+	EngineThreadPool *pool;
+
+	struct Point;
+	// Receives p_count values of one stem, p_offset counts int16 values from the start of the stem
+	typedef std::function<void(int p_stem, int p_offset, const uint16_t *p_pcm, int p_count)> StemWriter;
+
+	int get_channel_count() const {return stereo ? 2 : 1;}
+	int layout_points(std::vector<Point> &p_points) const;
+	int get_data_size() const;
+	bool render_stems(const StemWriter &p_write, bool p_header = true);
 
 public:
 	static void _register_methods();
@@ -62,7 +81,23 @@ public:
 	void set_include_audio_header(bool p_include) {include_audio_header = p_include;}
 	bool get_include_audio_header() const {return include_audio_header;}
 
+	// The model renders the same signal on every channel, mono banks are half the size
+	void set_stereo(bool p_stereo) {stereo = p_stereo;}
+	bool get_stereo() const {return stereo;}
+
+	// Codec of the stems in record_to_bank, the in-band format of record is always PCM16
+	void set_bank_codec(int p_codec) {bank_codec = p_codec == ENGINE_BANK_CODEC_ADPCM ? ENGINE_BANK_CODEC_ADPCM : ENGINE_BANK_CODEC_PCM16;}
+	int get_bank_codec() const {return bank_codec;}
+
+	// Rpm points render in parallel, 0 uses one thread per hardware thread
+	void set_thread_count(int p_count) {thread_count = p_count > 0 ? p_count : 0;}
+	int get_thread_count() const {return thread_count;}
+
 	void record();
+	// Streams the stems into 16 bit wave files instead of keeping them in memory
+	Error record_to_files(String p_crankshaft_path, String p_ignition_path, String p_exhaust_path);
+	// Streams all stems into one bank container, see engine_bank_file.h
+	Error record_to_bank(String p_path);
 	Ref<AudioStreamSample> get_crankshaft_recording() const {return crankshaft_recording;}
 	Ref<AudioStreamSample> get_ignition_recording() const {return ignition_recording;}
 	Ref<AudioStreamSample> get_exhaust_recording() const {return exhaust_recording;}
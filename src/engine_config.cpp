@@ -1,5 +1,6 @@
 #include "engine_config.h"
 #include "engine_utils.h"
+#include "engine_audio_monitors.h"
 
 using namespace godot;
 
@@ -12,6 +13,9 @@ void EngineConfig::update_muffler_elements(Array new_elements) {
 		if (muf_res->is_connected("changed", this, "on_muffler_changed")) {
 			muf_res->disconnect("changed", this, "on_muffler_changed");
 		}
+		if (muf_res->is_connected("pipe_length_changed", this, "on_element_pipe_length_changed")) {
+			muf_res->disconnect("pipe_length_changed", this, "on_element_pipe_length_changed");
+		}
 	}
 	muffler_elements_output = new_elements;
 	count = muffler_elements_output.size();
@@ -20,6 +24,7 @@ void EngineConfig::update_muffler_elements(Array new_elements) {
 		ERR_FAIL_COND(!muf_res);
 
 		muf_res->connect("changed", this, "on_muffler_changed");
+		muf_res->connect("pipe_length_changed", this, "on_element_pipe_length_changed");
 	}
 }
 
@@ -32,6 +37,9 @@ void EngineConfig::update_cylinder_elements(Array new_elements) {
 		if (cyl_res->is_connected("changed", this, "on_cylinder_changed")) {
 			cyl_res->disconnect("changed", this, "on_cylinder_changed");
 		}
+		if (cyl_res->is_connected("pipe_length_changed", this, "on_element_pipe_length_changed")) {
+			cyl_res->disconnect("pipe_length_changed", this, "on_element_pipe_length_changed");
+		}
 	}
 	cylinder_elements = new_elements;
 	count = cylinder_elements.size();
@@ -40,451 +48,111 @@ void EngineConfig::update_cylinder_elements(Array new_elements) {
 		ERR_FAIL_COND(!cyl_res);
 
 		cyl_res->connect("changed", this, "on_cylinder_changed");
+		cyl_res->connect("pipe_length_changed", this, "on_element_pipe_length_changed");
 	}
 }
 
-void EngineConfig::build_engine() {
-	engine_valid = false;
-	engine_dirty = true;
-
-	if (!engine) {
-		engine = new EngineMain();
-	}
+bool EngineConfig::snapshot_params() {
+	EngineParams &params = synth->params;
 
-	if (!dc_filter) {
-		dc_filter = new LowPassFilter(
-			dc_filter_frequency, sample_rate
-		);
-	} else {
-		dc_filter->modify(
-			dc_filter_frequency, sample_rate
-		);
-	}
-	
-	engine->intake_noise_factor = intake_noise_factor;
-	engine->intake_valve_shift = intake_valve_shift;
-	engine->exhaust_valve_shift = exhaust_valve_shift;
-	engine->crankshaft_fluctuation = crankshaft_fluctuation;
-
-	if (!engine->intake_noise) {
-		engine->intake_noise = new Noise();
-		// engine->intake_noise->set_octaves(3);
-	}
-	if (!engine->crankshaft_noise) {
-		engine->crankshaft_noise = new Noise();
-		// engine->crankshaft_noise->set_octaves(3);
-	}
-	
-	if (!engine->intake_noise_lp) {
-		engine->intake_noise_lp = new LowPassFilter(intake_noise_filter_frequency, sample_rate);
-	} else {
-		engine->intake_noise_lp->modify(intake_noise_filter_frequency, sample_rate);
-	}
+	params.sample_rate = sample_rate;
+	params.max_pipe_length = max_pipe_length;
 
-	if (!engine->vibration_filter) {
-		engine->vibration_filter = new LowPassFilter(vibrations_filter_frequency, sample_rate);
-	} else {
-		engine->vibration_filter->modify(vibrations_filter_frequency, sample_rate);
-	}
+	params.vibrations_filter_frequency = vibrations_filter_frequency;
+	params.intake_noise_factor = intake_noise_factor;
+	params.intake_noise_filter_frequency = intake_noise_filter_frequency;
+	params.intake_valve_shift = intake_valve_shift;
+	params.exhaust_valve_shift = exhaust_valve_shift;
+	params.crankshaft_fluctuation = crankshaft_fluctuation;
+	params.crankshaft_fluctuation_filter_frequency = crankshaft_fluctuation_filter_frequency;
+	params.intake_noise_seed = intake_noise_seed;
+	params.crankshaft_noise_seed = crankshaft_noise_seed;
 
-	if (!engine->crankshaft_fluctuation_lp) {
-		engine->crankshaft_fluctuation_lp = new LowPassFilter(crankshaft_fluctuation_filter_frequency, sample_rate);
-	} else {
-		engine->crankshaft_fluctuation_lp->modify(crankshaft_fluctuation_filter_frequency, sample_rate);
-	}
+	params.straight_pipe_extractor_side_refl = straight_pipe_extractor_side_refl;
+	params.straight_pipe_muffler_side_refl = straight_pipe_muffler_side_refl;
+	params.straight_pipe_length = straight_pipe_length;
+	params.output_side_refl = output_side_refl;
 
-	// Build cylinders
-	{
-		uint32_t cylinder_count = cylinder_elements.size();
-		size_t prev_cylinder_count = engine->cylinders.size();
+	uint32_t muffler_count = muffler_elements_output.size();
+	params.muffler_cavity_lengths.resize(muffler_count);
 
-		if (cylinder_count < prev_cylinder_count) {
-			for (uint32_t i = cylinder_count; i < prev_cylinder_count; i++) {
-				delete engine->cylinders[i];
-			}
-		}
+	for (uint32_t i = 0; i < muffler_count; i++) {
+		EngineMufflerConfig *muf_res = Object::cast_to<EngineMufflerConfig>(muffler_elements_output[i]);
+		ERR_FAIL_COND_V(!muf_res, false);
 
-		engine->cylinders.resize(cylinder_count, nullptr);
-
-		for (uint32_t i = 0; i < cylinder_count; i++) {
-			EngineCylinderConfig *cyl_res = Object::cast_to<EngineCylinderConfig>(cylinder_elements[i]);
-			ERR_FAIL_COND(!cyl_res);
-
-			EngineCylinder *cyl = nullptr;
-
-			if (i < prev_cylinder_count) {
-				cyl = engine->cylinders[i];
-			}
-
-			if (!cyl) {
-				cyl = new EngineCylinder();
-			}
-
-			cyl->piston_motion_factor = cyl_res->get_piston_motion_factor();
-			cyl->ignition_factor = cyl_res->get_ignition_factor();
-			cyl->crank_offset = cyl_res->get_crank_offset();
-			cyl->ignition_time = cyl_res->get_ignition_time();
-			cyl->intake_open_refl = cylinder_intake_opened_refl;
-			cyl->intake_closed_refl = cylinder_intake_closed_refl;
-			cyl->exhaust_open_refl = cylinder_exhaust_opened_refl;
-			cyl->exhaust_closed_refl = cylinder_exhaust_closed_refl;
-
-			if (!cyl->intake_waveguide) {
-				cyl->intake_waveguide = new WaveGuide(
-					distance_to_samples(cyl_res->get_intake_pipe_length(), sample_rate),
-					1.0f,
-					cylinder_intake_open_end_refl,
-					sample_rate
-				);
-			} else {
-				cyl->intake_waveguide->modify(
-					distance_to_samples(cyl_res->get_intake_pipe_length(), sample_rate),
-					1.0f,
-					cylinder_intake_open_end_refl,
-					sample_rate
-				);
-			}
-
-			if (!cyl->exhaust_waveguide) {
-				cyl->exhaust_waveguide = new WaveGuide(
-					distance_to_samples(cyl_res->get_exhaust_pipe_length(), sample_rate),
-					0.71f,
-					0.06f,
-					sample_rate
-				);
-			} else {
-				cyl->exhaust_waveguide->modify(
-					distance_to_samples(cyl_res->get_exhaust_pipe_length(), sample_rate),
-					0.71f,
-					0.06f,
-					sample_rate
-				);
-			}
-
-			if (!cyl->extractor_waveguide) {
-				cyl->extractor_waveguide = new WaveGuide(
-					distance_to_samples(cyl_res->get_extractor_pipe_length(), sample_rate),
-					0.0,
-					cylinder_extractor_open_end_refl,
-					sample_rate
-				);
-			} else {
-				cyl->extractor_waveguide->modify(
-					distance_to_samples(cyl_res->get_extractor_pipe_length(), sample_rate),
-					0.0,
-					cylinder_extractor_open_end_refl,
-					sample_rate
-				);
-			}
-
-			engine->cylinders[i] = cyl;
-		}
+		params.muffler_cavity_lengths[i] = muf_res->get_cavity_length();
 	}
 
-	// Build mufflers
-	{
-		if (!engine->muffler) {
-			engine->muffler = new EngineMuffler();
-		}
-		EngineMuffler *muffler = engine->muffler;
-
-		uint32_t muffler_count = muffler_elements_output.size();
-		size_t prev_muffler_count = muffler->muffler_elements.size();
+	params.cylinder_intake_opened_refl = cylinder_intake_opened_refl;
+	params.cylinder_intake_closed_refl = cylinder_intake_closed_refl;
+	params.cylinder_exhaust_opened_refl = cylinder_exhaust_opened_refl;
+	params.cylinder_exhaust_closed_refl = cylinder_exhaust_closed_refl;
+	params.cylinder_intake_open_end_refl = cylinder_intake_open_end_refl;
+	params.cylinder_extractor_open_end_refl = cylinder_extractor_open_end_refl;
 
-		if (muffler_count < prev_muffler_count) {
-			for (uint32_t i = muffler_count; i < prev_muffler_count; i++) {
-				delete muffler->muffler_elements[i];
-			}
-		}
+	uint32_t cylinder_count = cylinder_elements.size();
+	params.cylinders.resize(cylinder_count);
 
-		if (!muffler->straight_pipe) {
-			muffler->straight_pipe = new WaveGuide(
-				distance_to_samples(straight_pipe_length, sample_rate),
-				straight_pipe_extractor_side_refl,
-				straight_pipe_muffler_side_refl,
-				sample_rate
-			);
-		} else {
-			muffler->straight_pipe->modify(
-				distance_to_samples(straight_pipe_length, sample_rate),
-				straight_pipe_extractor_side_refl,
-				straight_pipe_muffler_side_refl,
-				sample_rate
-			);
-		}
-
-		muffler->muffler_elements.resize(muffler_count, nullptr);
-
-		for (uint32_t i = 0; i < muffler_count; i++) {
-			EngineMufflerConfig *muf_res = Object::cast_to<EngineMufflerConfig>(muffler_elements_output[i]);
-			ERR_FAIL_COND(!muf_res);
-
-			WaveGuide *muf = nullptr;
-
-			if (i < prev_muffler_count) {
-				muf = muffler->muffler_elements[i];
-				if (muf) {
-					muf->modify(
-						distance_to_samples(muf_res->get_cavity_length(), sample_rate),
-						0.0,
-						output_side_refl,
-						sample_rate
-					);
-				}
-			}
-
-			if (!muf) {
-				muf = new WaveGuide(
-					distance_to_samples(muf_res->get_cavity_length(), sample_rate),
-					0.0,
-					output_side_refl,
-					sample_rate
-				);
-			}
-
-			muffler->muffler_elements[i] = muf;
-		}
-
-		engine->muffler = muffler;
+	for (uint32_t i = 0; i < cylinder_count; i++) {
+		EngineCylinderConfig *cyl_res = Object::cast_to<EngineCylinderConfig>(cylinder_elements[i]);
+		ERR_FAIL_COND_V(!cyl_res, false);
+
+		EngineCylinderParams &cyl = params.cylinders[i];
+		cyl.piston_motion_factor = cyl_res->get_piston_motion_factor();
+		cyl.ignition_factor = cyl_res->get_ignition_factor();
+		cyl.ignition_time = cyl_res->get_ignition_time();
+		cyl.intake_pipe_length = cyl_res->get_intake_pipe_length();
+		cyl.exhaust_pipe_length = cyl_res->get_exhaust_pipe_length();
+		cyl.extractor_pipe_length = cyl_res->get_extractor_pipe_length();
+		cyl.crank_offset = cyl_res->get_crank_offset();
 	}
 
-	engine_dirty = false;
-	engine_valid = true;
+	return true;
 }
 
-void EngineConfig::gen(float &intake_channel, float &vibrations_channel, float &exhaust_channel, bool &channels_dampened) {
-	ERR_FAIL_COND(!engine_valid);
-
-	// float noise_cos = Math::cos(engine->noise_pos * (float)Math_TAU) * 500.f;
-	// float noise_sin = Math::cos(engine->noise_pos * (float)Math_TAU) * 500.f;
-	// engine->intake_noise->set_repeat((int32_t)(500.f * intake_noise_frequency));
-	// engine->crankshaft_noise->set_repeat((int32_t)(500.f * crankshaft_fluctuation_frequency));
-	float intake_noise = engine->intake_noise_lp->filter(
-		engine->intake_noise->next_f32()
-		// engine->intake_noise->get(
-		// 	engine->noise_pos * 500.f * intake_noise_frequency,
-		// 	0.f
-		// )
-	) * engine->intake_noise_factor;
-
-	float vibrations = 0.0;
-
-	size_t cylinder_count = engine->cylinders.size();
-	float num_cyl = (float)cylinder_count;
-
-	float last_exhaust_collector = engine->exhaust_collector / num_cyl;
-	engine->exhaust_collector = 0.0;
-	engine->intake_collector = 0.0;
-
-	float crankshaft_fluctuation_off = engine->crankshaft_fluctuation_lp->filter(
-		engine->crankshaft_noise->next_f32()
-		// engine->crankshaft_noise->get(
-		// 	engine->noise_pos * 500.f * crankshaft_fluctuation_frequency,
-		// 	0.f
-		// )
-	);
-
-	bool cylinder_dampened = false;
-
-	for (size_t i = 0; i < cylinder_count; i++) {
-		EngineCylinder *cylinder = engine->cylinders[i];
-
-		float cyl_intake;
-		float cyl_exhaust;
-		float cyl_vib;
-		bool cyl_dampened;
-		cylinder->pop(
-			engine->crankshaft_pos +
-				engine->crankshaft_fluctuation * crankshaft_fluctuation_off,
-			last_exhaust_collector,
-			engine->intake_valve_shift,
-			engine->exhaust_valve_shift,
-			cyl_intake, cyl_exhaust, cyl_vib, cyl_dampened
-		);
-
-		engine->intake_collector += cyl_intake;
-		engine->exhaust_collector += cyl_exhaust;
-
-		vibrations += cyl_vib;
-		cylinder_dampened = cylinder_dampened || cyl_dampened;
-	}
-
-	float straight_pipe_c1, straight_pipe_c0;
-	bool straight_pipe_dampened;
-	engine->muffler->straight_pipe->pop(straight_pipe_c1, straight_pipe_c0, straight_pipe_dampened);
-
-	float muffler_c1 = 0.0, muffler_c0 = 0.0;
-	bool muffler_dampened = false;
-
-	size_t muffler_count = engine->muffler->muffler_elements.size();
-
-	for (size_t i = 0; i < muffler_count; i++) {
-		WaveGuide *muffler_line = engine->muffler->muffler_elements[i];
-		float muffler_line_c1, muffler_line_c0;
-		bool muffler_line_dampened;
-		muffler_line->pop(muffler_line_c1, muffler_line_c0, muffler_line_dampened);
-		muffler_c1 += muffler_line_c1;
-		muffler_c0 += muffler_line_c0;
-		muffler_dampened = muffler_dampened || muffler_line_dampened;
-	}
-
-	for (size_t i = 0; i < cylinder_count; i++) {
-		EngineCylinder *cylinder = engine->cylinders[i];
-
-		cylinder->push(
-			engine->intake_collector / num_cyl +
-				intake_noise * intake_valve(
-					Math::fmod(engine->crankshaft_pos + cylinder->crank_offset, 1.0f)
-				)
-		);
-	}
-
-	engine->muffler->straight_pipe->push(
-		engine->exhaust_collector, muffler_c1
-	);
-	engine->exhaust_collector += straight_pipe_c1;
-
-	float num_muffler = (float)muffler_count;
-
-	for (size_t i = 0; i < muffler_count; i++) {
-		WaveGuide *muffler_delay_line = engine->muffler->muffler_elements[i];
-		muffler_delay_line->push(straight_pipe_c0 / num_muffler, 0.0);
+bool EngineConfig::update_engine() {
+	if (params_dirty) {
+		if (!snapshot_params()) {
+			return false;
+		}
+		params_dirty = false;
 	}
 
-	vibrations = engine->vibration_filter->filter(vibrations);
-
-	intake_channel = engine->intake_collector;
-	vibrations_channel = vibrations;
-	exhaust_channel = muffler_c0;
-	channels_dampened = straight_pipe_dampened || cylinder_dampened;
+	return synth->update_engine();
 }
 
 void EngineConfig::clear_buffer() {
-	if (engine_dirty) {
-		build_engine();
-	}
-	ERR_FAIL_COND(!engine_valid);
-
-	engine->clear();
-	dc_filter->clear();
+	ERR_FAIL_COND(!update_engine());
+	synth->clear_buffer();
 }
 
 void EngineConfig::fill_buffer(float *p_buffer, int p_num_frames, int p_num_channels) {
-	if (engine_dirty) {
-		build_engine();
-	}
-
-	ERR_FAIL_COND(!engine_valid);
-
-	dc_filter->modify(
-		dc_filter_frequency, sample_rate
-	);
-
-	waveguides_dampened = false;
-
-	float inc = rpm / (sample_rate * 120.f);
-	float noise_inc = (rpm / (sample_rate * 120.f)) / 500.f;
-
-	for (int frame = 0; frame < p_num_frames; frame++) {
-		engine->crankshaft_pos = Math::fmod(engine->crankshaft_pos + inc, 1.f);
-		engine->noise_pos = Math::fmod(engine->noise_pos + noise_inc, 1.f);
-
-		float intake_channel;
-		float vibrations_channel;
-		float exhaust_channel;
-		bool channels_dampened;
-
-		gen(intake_channel, vibrations_channel, exhaust_channel, channels_dampened);
-	
-		intake_channel *= intake_volume;
-		vibrations_channel *= vibrations_volume;
-		exhaust_channel *= exhaust_volume;
-
-		float mixed = (intake_channel + vibrations_channel + exhaust_channel) * volume;
-
-		waveguides_dampened = waveguides_dampened || channels_dampened;
-
-		mixed -= dc_filter->filter(mixed);
-
-		for (int c = 0; c < p_num_channels; c++) {
-			p_buffer[frame * p_num_channels + c] = mixed;
-		}
-	}
+	ERR_FAIL_COND(!update_engine());
+	synth->fill_buffer(p_buffer, p_num_frames, p_num_channels);
 }
 
 void EngineConfig::fill_channel_buffers(float *p_intake_buffer, float *p_vibration_buffer, float *p_exhaust_buffer, int p_num_frames, int p_num_channels) {
-	if (engine_dirty) {
-		build_engine();
-	}
-
-	ERR_FAIL_COND(!engine_valid);
-
-	waveguides_dampened = false;
-
-	float inc = rpm / (sample_rate * 120.f);
-	float noise_inc = (rpm / (sample_rate * 120.f)) / 500.f;
-
-	for (int frame = 0; frame < p_num_frames; frame++) {
-		engine->crankshaft_pos = Math::fmod(engine->crankshaft_pos + inc, 1.f);
-		engine->noise_pos = Math::fmod(engine->noise_pos + noise_inc, 1.f);
-
-		float intake_channel;
-		float vibrations_channel;
-		float exhaust_channel;
-		bool channels_dampened;
-
-		gen(intake_channel, vibrations_channel, exhaust_channel, channels_dampened);
-	
-		intake_channel *= intake_volume * volume;
-		vibrations_channel *= vibrations_volume * volume;
-		exhaust_channel *= exhaust_volume * volume;
-
-		waveguides_dampened = waveguides_dampened || channels_dampened;
-
-		for (int c = 0; c < p_num_channels; c++) {
-			//p_buffer[frame * p_num_channels + c] = mixed;
-			p_intake_buffer[frame * p_num_channels + c] = intake_channel;
-			p_vibration_buffer[frame * p_num_channels + c] = vibrations_channel;
-			p_exhaust_buffer[frame * p_num_channels + c] = exhaust_channel;
-		}
-	}
+	ERR_FAIL_COND(!update_engine());
+	synth->fill_channel_buffers(p_intake_buffer, p_vibration_buffer, p_exhaust_buffer, p_num_frames, p_num_channels);
 }
 
 void EngineConfig::skip_frames(int p_num_frames) {
-	if (engine_dirty) {
-		build_engine();
-	}
-
-	ERR_FAIL_COND(!engine_valid);
-	
-	dc_filter->modify(
-		dc_filter_frequency, sample_rate
-	);
-
-	waveguides_dampened = false;
-
-	float inc = rpm / (sample_rate * 120.f);
-
-	for (int frame = 0; frame < p_num_frames; frame++) {
-		engine->crankshaft_pos = Math::fmod(engine->crankshaft_pos + inc, 1.f);
-
-		float intake_channel;
-		float vibrations_channel;
-		float exhaust_channel;
-		bool channels_dampened;
-
-		gen(intake_channel, vibrations_channel, exhaust_channel, channels_dampened);
-	
-		intake_channel *= intake_volume;
-		vibrations_channel *= vibrations_volume;
-		exhaust_channel *= exhaust_volume;
+	ERR_FAIL_COND(!update_engine());
+	synth->skip_frames(p_num_frames);
+}
 
-		float mixed = (intake_channel + vibrations_channel + exhaust_channel) * volume;
+float EngineConfig::get_crank_phase() {
+	ERR_FAIL_COND_V(!update_engine(), 0.f);
+	return synth->get_crank_phase();
+}
 
-		waveguides_dampened = waveguides_dampened || channels_dampened;
+void EngineConfig::set_crank_phase(float p_phase) {
+	ERR_FAIL_COND(!update_engine());
+	synth->set_crank_phase(p_phase);
+}
 
-		dc_filter->filter(mixed);
-	}
+Dictionary EngineConfig::get_render_stats() const {
+	return EngineAudioMonitors::snapshot_to_dictionary(synth->stats->get_snapshot());
 }
 
 void EngineConfig::_init() {
@@ -543,6 +211,54 @@ void EngineConfig::_register_methods() {
 		20050
 	);
 
+	register_property<EngineConfig, uint32_t>(
+		"output_sample_rate", 
+		&EngineConfig::set_output_sample_rate,
+		&EngineConfig::get_output_sample_rate,
+		0
+	);
+	register_property<EngineConfig, int>(
+		"resampler_quality", 
+		&EngineConfig::set_resampler_quality,
+		&EngineConfig::get_resampler_quality,
+		RESAMPLER_QUALITY_MEDIUM,
+		GODOT_METHOD_RPC_MODE_DISABLED,
+		GODOT_PROPERTY_USAGE_DEFAULT,
+		GODOT_PROPERTY_HINT_ENUM,
+		"Low,Medium,High"
+	);
+
+	register_property<EngineConfig, bool>(
+		"block_processing", 
+		&EngineConfig::set_block_processing,
+		&EngineConfig::get_block_processing,
+		true
+	);
+	register_property<EngineConfig, float>(
+		"max_pipe_length", 
+		&EngineConfig::set_max_pipe_length,
+		&EngineConfig::get_max_pipe_length,
+		4.0f
+	);
+	register_property<EngineConfig, bool>(
+		"background_rebuild", 
+		&EngineConfig::set_background_rebuild,
+		&EngineConfig::get_background_rebuild,
+		true
+	);
+	register_property<EngineConfig, uint32_t>(
+		"rebuild_crossfade_frames", 
+		&EngineConfig::set_rebuild_crossfade_frames,
+		&EngineConfig::get_rebuild_crossfade_frames,
+		1024
+	);
+	register_property<EngineConfig, float>(
+		"rebuild_preheat_time", 
+		&EngineConfig::set_rebuild_preheat_time,
+		&EngineConfig::get_rebuild_preheat_time,
+		0.5f
+	);
+
 	register_property<EngineConfig, float>(
 		"vibrations_filter_frequency", 
 		&EngineConfig::set_vibrations_filter_frequency,
@@ -597,6 +313,18 @@ void EngineConfig::_register_methods() {
 		&EngineConfig::get_crankshaft_fluctuation_filter_frequency,
 		57.0f
 	);
+	register_property<EngineConfig, uint32_t>(
+		"intake_noise_seed", 
+		&EngineConfig::set_intake_noise_seed,
+		&EngineConfig::get_intake_noise_seed,
+		0
+	);
+	register_property<EngineConfig, uint32_t>(
+		"crankshaft_noise_seed", 
+		&EngineConfig::set_crankshaft_noise_seed,
+		&EngineConfig::get_crankshaft_noise_seed,
+		0
+	);
 
 	register_property<EngineConfig, float>(
 		"straight_pipe_extractor_side_refl", 
@@ -681,10 +409,16 @@ void EngineConfig::_register_methods() {
 	);
 
 	register_method("clear_buffer", &EngineConfig::clear_buffer);
+	register_method("get_crank_phase", &EngineConfig::get_crank_phase);
+	register_method("set_crank_phase", &EngineConfig::set_crank_phase);
 	register_method("skip_frames", &EngineConfig::skip_frames);
+	register_method("get_render_stats", &EngineConfig::get_render_stats);
+	register_method("reset_render_stats", &EngineConfig::reset_render_stats);
 
 	register_method("on_cylinder_changed", &EngineConfig::on_cylinder_changed);
 	register_method("on_muffler_changed", &EngineConfig::on_muffler_changed);
+	register_method("on_pipe_length_changed", &EngineConfig::on_pipe_length_changed);
+	register_method("on_element_pipe_length_changed", &EngineConfig::on_element_pipe_length_changed);
 
 	/*
 	"17/19:EngineCylinderConfig"*/
@@ -733,6 +467,8 @@ void EngineCylinderConfig::_register_methods() {
 		&EngineCylinderConfig::get_crank_offset,
 		0.0f
 	);
+
+	register_signal<EngineCylinderConfig>("pipe_length_changed", Dictionary());
 }
 
 void EngineMufflerConfig::_register_methods() {
@@ -742,16 +478,16 @@ void EngineMufflerConfig::_register_methods() {
 		&EngineMufflerConfig::get_cavity_length,
 		0.04f
 	);
+
+	register_signal<EngineMufflerConfig>("pipe_length_changed", Dictionary());
 }
 
 EngineConfig::EngineConfig() {
-	rpm = 1000.f;
-	volume = 0.5f;
-	intake_volume = 0.5f;
-	exhaust_volume = 0.25f;
-	vibrations_volume = 0.1f;
-	dc_filter_frequency = 0.5f;
+	synth = new EngineSynth();
+	params_dirty = true;
+	element_pipe_length_changed = false;
 	sample_rate = 20050;
+	max_pipe_length = 4.0f;
 
 	vibrations_filter_frequency = 92.0f;
 	intake_noise_factor = 0.2f;
@@ -762,6 +498,8 @@ EngineConfig::EngineConfig() {
 	crankshaft_fluctuation = 0.3f;
 	crankshaft_fluctuation_frequency = 100.0f;
 	crankshaft_fluctuation_filter_frequency = 57.0f;
+	intake_noise_seed = 0;
+	crankshaft_noise_seed = 0;
 
 	straight_pipe_extractor_side_refl = 0.06f;
 	straight_pipe_muffler_side_refl = 0.0f;
@@ -802,21 +540,10 @@ EngineConfig::EngineConfig() {
 		0.08f, 0.1f, 0.1f,
 		4.f / 8.f
 	));
-
-	engine = nullptr;
-	engine_valid = false;
-	dc_filter = nullptr;
-	engine_dirty = true;
 }
 
 EngineConfig::~EngineConfig() {
-	if (engine) {
-		delete engine;
-	}
-
-	if (dc_filter) {
-		delete dc_filter;
-	}
+	delete synth;
 }
 
 EngineCylinderConfig::EngineCylinderConfig() {
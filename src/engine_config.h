@@ -4,7 +4,8 @@
 #include <Godot.hpp>
 #include <Resource.hpp>
 #include <Array.hpp>
-#include "engine_parts.h"
+#include <Dictionary.hpp>
+#include "engine_synth.h"
 
 namespace godot {
 
@@ -15,20 +16,16 @@ class EngineMufflerConfig;
 class EngineConfig : public Resource {
 	GODOT_CLASS(EngineConfig, Resource);
 private:
-	EngineMain *engine;
-	bool engine_valid;
-	LowPassFilter *dc_filter;
-	bool engine_dirty;
-
-	// Mix
-	float rpm;
-	float volume;
-	float intake_volume;
-	float exhaust_volume;
-	float vibrations_volume;
-	float dc_filter_frequency;
-	bool waveguides_dampened;
+	// The engine itself, the properties below are copied into its params before rendering
+	EngineSynth *synth;
+	bool params_dirty;
+
+	// Element pipe length setters emit pipe_length_changed right before changed,
+	// the changed that follows only needs the delays updated
+	bool element_pipe_length_changed;
+
 	uint32_t sample_rate;
+	float max_pipe_length;
 
 	// Engine params
 	float vibrations_filter_frequency;
@@ -40,6 +37,8 @@ private:
 	float crankshaft_fluctuation;
 	float crankshaft_fluctuation_frequency;
 	float crankshaft_fluctuation_filter_frequency;
+	uint32_t intake_noise_seed;
+	uint32_t crankshaft_noise_seed;
 
 	// Muffler params
 	float straight_pipe_extractor_side_refl;
@@ -59,35 +58,48 @@ private:
 
 private:
 	void on_muffler_changed() {
-		engine_dirty = true;
-		emit_changed();
+		if (element_pipe_length_changed) {
+			element_pipe_length_changed = false;
+			return;
+		}
+		mark_dirty();
 	}
 
 	void on_cylinder_changed() {
-		engine_dirty = true;
+		if (element_pipe_length_changed) {
+			element_pipe_length_changed = false;
+			return;
+		}
+		mark_dirty();
+	}
+
+	void on_element_pipe_length_changed() {
+		element_pipe_length_changed = true;
+		on_pipe_length_changed();
+	}
+
+	void on_pipe_length_changed() {
+		params_dirty = true;
+		synth->mark_delays_dirty();
 		emit_changed();
 	}
 
 	void update_muffler_elements(Array new_elements);
 	void update_cylinder_elements(Array new_elements);
 
-	void build_engine();
-	void gen(float &intake_channel, float &vibrations_channel, float &exhaust_channel, bool &channels_dampened);
+	bool snapshot_params();
+	bool update_engine();
 public:
 	static void _register_methods();
 
 	//EngineMain *get_engine();
 
-	bool is_engine_dirty() {return engine_dirty;}
-	bool is_engine_valid() {
-		if (engine_dirty) {
-			build_engine();
-		}
-		return engine_valid;
-	}
+	bool is_engine_dirty() {return synth->is_engine_dirty();}
+	bool is_engine_valid() {return update_engine();}
 
 	void mark_dirty() {
-		engine_dirty = true;
+		params_dirty = true;
+		synth->mark_dirty();
 		emit_changed();
 	}
 
@@ -97,44 +109,43 @@ public:
 	void fill_channel_buffers(float *p_intake_buffer, float *p_vibration_buffer, float *p_exhaust_buffer, int p_num_frames, int p_num_channels);
 	void skip_frames(int p_num_frames);
 
-	// Mixer
-	void set_rpm(float p_rpm) {
-		rpm = p_rpm;
-		emit_changed();
-	}
-	float get_rpm() const {return rpm;}
+	// Crank position in turns of the engine cycle, used to line up other renderers
+	float get_crank_phase();
+	void set_crank_phase(float p_phase);
 
-	void set_volume(float p_volume) {
-		volume = p_volume;
-		emit_changed();
-	}
-	float get_volume() const {return volume;}
+	// For renderers off the main thread, update_engine has to have run on the main thread
+	EngineSynth *get_synth() {return synth;}
 
-	void set_intake_volume(float p_volume) {
-		intake_volume = p_volume;
-		emit_changed();
-	}
-	float get_intake_volume() const {return intake_volume;}
+	// Mixer, these are written every frame so they don't emit changed, the renderer
+	// picks them up at the start of its next block
+	EngineControls *get_controls() {return synth->controls;}
 
-	void set_exhaust_volume(float p_volume) {
-		exhaust_volume = p_volume;
-		emit_changed();
-	}
-	float get_exhaust_volume() const {return exhaust_volume;}
+	void set_rpm(float p_rpm) {synth->controls->set_rpm(p_rpm);}
+	float get_rpm() const {return synth->controls->state.rpm;}
 
-	void set_vibrations_volume(float p_volume) {
-		vibrations_volume = p_volume;
-		emit_changed();
-	}
-	float get_vibrations_volume() const {return vibrations_volume;}
+	void set_volume(float p_volume) {synth->controls->set_volume(p_volume);}
+	float get_volume() const {return synth->controls->state.volume;}
+
+	void set_intake_volume(float p_volume) {synth->controls->set_intake_volume(p_volume);}
+	float get_intake_volume() const {return synth->controls->state.intake_volume;}
+
+	void set_exhaust_volume(float p_volume) {synth->controls->set_exhaust_volume(p_volume);}
+	float get_exhaust_volume() const {return synth->controls->state.exhaust_volume;}
+
+	void set_vibrations_volume(float p_volume) {synth->controls->set_vibrations_volume(p_volume);}
+	float get_vibrations_volume() const {return synth->controls->state.vibrations_volume;}
 
 	void set_dc_filter_frequency(float p_freq) {
-		dc_filter_frequency = p_freq;
+		synth->dc_filter_frequency = p_freq;
 		emit_changed();
 	}
-	float get_dc_filter_frequency() const {return dc_filter_frequency;}
+	float get_dc_filter_frequency() const {return synth->dc_filter_frequency;}
+
+	bool get_waveguides_dampened() const {return synth->get_waveguides_dampened();}
 
-	bool get_waveguides_dampened() const {return waveguides_dampened;}
+	// Render and rebuild timing of this config, see EngineAudioMonitors for the totals
+	Dictionary get_render_stats() const;
+	void reset_render_stats() {synth->stats->reset();}
 
 	void set_sample_rate(uint32_t p_rate) {
 		sample_rate = p_rate;
@@ -142,6 +153,31 @@ public:
 	}
 	uint32_t get_sample_rate() const {return sample_rate;}
 
+	// Not part of the engine, changing them keeps the engine as it is
+	void set_output_sample_rate(uint32_t p_rate) {synth->output_sample_rate = p_rate;}
+	uint32_t get_output_sample_rate() const {return synth->output_sample_rate;}
+
+	void set_resampler_quality(int p_quality) {synth->resampler_quality = p_quality;}
+	int get_resampler_quality() const {return synth->resampler_quality;}
+
+	void set_block_processing(bool p_enabled) {synth->block_processing = p_enabled;}
+	bool get_block_processing() const {return synth->block_processing;}
+
+	void set_max_pipe_length(float p_length) {
+		max_pipe_length = p_length;
+		mark_dirty();
+	}
+	float get_max_pipe_length() const {return max_pipe_length;}
+
+	void set_background_rebuild(bool p_enabled) {synth->background_rebuild = p_enabled;}
+	bool get_background_rebuild() const {return synth->background_rebuild;}
+
+	void set_rebuild_crossfade_frames(uint32_t p_frames) {synth->rebuild_crossfade_frames = p_frames;}
+	uint32_t get_rebuild_crossfade_frames() const {return synth->rebuild_crossfade_frames;}
+
+	void set_rebuild_preheat_time(float p_time) {synth->rebuild_preheat_time = p_time;}
+	float get_rebuild_preheat_time() const {return synth->rebuild_preheat_time;}
+
 	// Engine params
 	void set_vibrations_filter_frequency(float p_frequency) {
 		vibrations_filter_frequency = p_frequency;
@@ -197,6 +233,19 @@ public:
 	}
 	float get_crankshaft_fluctuation_filter_frequency() const {return crankshaft_fluctuation_filter_frequency;}
 
+	// 0 seeds the noise from the clock, anything else renders the same after every clear_buffer
+	void set_intake_noise_seed(uint32_t p_seed) {
+		intake_noise_seed = p_seed;
+		mark_dirty();
+	}
+	uint32_t get_intake_noise_seed() const {return intake_noise_seed;}
+
+	void set_crankshaft_noise_seed(uint32_t p_seed) {
+		crankshaft_noise_seed = p_seed;
+		mark_dirty();
+	}
+	uint32_t get_crankshaft_noise_seed() const {return crankshaft_noise_seed;}
+
 	// Muffler params
 	void set_straight_pipe_extractor_side_refl(float p_factor) {
 		straight_pipe_extractor_side_refl = p_factor;
@@ -212,7 +261,7 @@ public:
 
 	void set_straight_pipe_length(float p_factor) {
 		straight_pipe_length = p_factor;
-		mark_dirty();
+		on_pipe_length_changed();
 	}
 	float get_straight_pipe_length() const {return straight_pipe_length;}
 
@@ -331,18 +380,21 @@ public:
 
 	void set_intake_pipe_length(float p_length) {
 		intake_pipe_length = p_length;
+		emit_signal("pipe_length_changed");
 		emit_changed();
 	}
 	float get_intake_pipe_length() const {return intake_pipe_length;}
 
 	void set_exhaust_pipe_length(float p_length) {
 		exhaust_pipe_length = p_length;
+		emit_signal("pipe_length_changed");
 		emit_changed();
 	}
 	float get_exhaust_pipe_length() const {return exhaust_pipe_length;}
 
 	void set_extractor_pipe_length(float p_length) {
 		extractor_pipe_length = p_length;
+		emit_signal("pipe_length_changed");
 		emit_changed();
 	}
 	float get_extractor_pipe_length() const {return extractor_pipe_length;}
@@ -373,6 +425,7 @@ public:
 
 	void set_cavity_length(float p_length) {
 		cavity_length = p_length;
+		emit_signal("pipe_length_changed");
 		emit_changed();
 	}
 	float get_cavity_length() const {return cavity_length;}
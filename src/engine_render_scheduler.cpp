@@ -0,0 +1,98 @@
+#include "engine_render_scheduler.h"
+#include <algorithm>
+
+using namespace godot;
+
+void EngineRenderScheduler::add_generator(Ref<EngineAudioGenerator> p_generator) {
+	ERR_FAIL_COND(!p_generator.is_valid());
+
+	generators.append(p_generator);
+}
+
+void EngineRenderScheduler::remove_generator(Ref<EngineAudioGenerator> p_generator) {
+	generators.erase(p_generator);
+}
+
+void EngineRenderScheduler::fill_buffers(int p_max_frames) {
+	if (!pool) {
+		pool = new EngineThreadPool();
+	}
+	pool->resize((uint32_t)thread_count);
+
+	// Playbacks are read on this thread before and written after rendering
+	pending.clear();
+
+	int count = generators.size();
+	for (int i = 0; i < count; i++) {
+		EngineAudioGenerator *generator = Object::cast_to<EngineAudioGenerator>(generators[i]);
+		if (!generator) {
+			WARN_PRINT("Render scheduler entry is not an EngineAudioGenerator");
+			continue;
+		}
+
+		if (generator->prepare_buffer(p_max_frames) > 0) {
+			pending.push_back(generator);
+		}
+	}
+
+	// A config's synth can't render on two threads, so generators sharing one
+	// become a single task
+	std::stable_sort(pending.begin(), pending.end(), [](EngineAudioGenerator *a, EngineAudioGenerator *b) {
+		return a->get_engine_configuration().ptr() < b->get_engine_configuration().ptr();
+	});
+
+	groups.clear();
+	for (size_t i = 0; i < pending.size(); i++) {
+		if (i == 0 || pending[i]->get_engine_configuration() != pending[i - 1]->get_engine_configuration()) {
+			groups.push_back((uint32_t)i);
+		}
+	}
+	groups.push_back((uint32_t)pending.size());
+
+	pool->run((uint32_t)groups.size() - 1, [this](uint32_t g) {
+		for (uint32_t i = groups[g]; i < groups[g + 1]; i++) {
+			pending[i]->render_buffer();
+		}
+	});
+
+	for (size_t i = 0; i < pending.size(); i++) {
+		pending[i]->push_rendered_buffer();
+	}
+	pending.clear();
+}
+
+void EngineRenderScheduler::_init() {
+	
+}
+
+void EngineRenderScheduler::_register_methods() {
+	register_property<EngineRenderScheduler, Array>(
+		"generators", 
+		&EngineRenderScheduler::set_generators,
+		&EngineRenderScheduler::get_generators,
+		Array()
+	);
+	register_property<EngineRenderScheduler, int>(
+		"thread_count", 
+		&EngineRenderScheduler::set_thread_count,
+		&EngineRenderScheduler::get_thread_count,
+		0
+	);
+
+	register_method("add_generator", &EngineRenderScheduler::add_generator);
+	register_method("remove_generator", &EngineRenderScheduler::remove_generator);
+	register_method("clear_generators", &EngineRenderScheduler::clear_generators);
+	register_method("fill_buffers", &EngineRenderScheduler::fill_buffers);
+}
+
+EngineRenderScheduler::EngineRenderScheduler() {
+	this->generators = Array();
+	this->thread_count = 0;
+	this->pool = nullptr;
+}
+
+EngineRenderScheduler::~EngineRenderScheduler() {
+	if (this->pool) {
+		delete this->pool;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef ENGINE_RENDER_SCHEDULER_H
+#define ENGINE_RENDER_SCHEDULER_H
+
+#include <Godot.hpp>
+#include <Reference.hpp>
+#include <Ref.hpp>
+#include <Array.hpp>
+#include "engine_audio_generator.h"
+#include "engine_thread_pool.h"
+
+namespace godot {
+
+// Fills many EngineAudioGenerators at once. Rendering runs on a thread pool, the
+// playbacks are only touched from the thread calling fill_buffers. Generators sharing
+// an EngineConfig render one after another on the same thread, give each its own
+// config to render them in parallel.
+class EngineRenderScheduler : public Reference {
+	GODOT_CLASS(EngineRenderScheduler, Reference)
+private:
+	Array generators;
+	int thread_count;
+
+	EngineThreadPool *pool;
+	std::vector<EngineAudioGenerator *> pending;
+	// Start of each run of pending generators sharing a config, and the end
+	std::vector<uint32_t> groups;
+public:
+	static void _register_methods();
+
+	void set_generators(Array p_generators) {generators = p_generators;}
+	Array get_generators() const {return generators;}
+
+	void set_thread_count(int p_count) {thread_count = p_count > 0 ? p_count : 0;}
+	int get_thread_count() const {return thread_count;}
+
+	void add_generator(Ref<EngineAudioGenerator> p_generator);
+	void remove_generator(Ref<EngineAudioGenerator> p_generator);
+	void clear_generators() {generators = Array();}
+
+	void fill_buffers(int p_max_frames);
+
+	void _init();
+
+	EngineRenderScheduler();
+	~EngineRenderScheduler();
+};
+
+}
+
+#endif // ENGINE_RENDER_SCHEDULER_H
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include "engine_audio_recorder.h"
 #include "procedural_engine_audio.h"
 #include "engine_audio_player.h"
+#include "engine_render_scheduler.h"
+#include "engine_audio_hybrid.h"
+#include "engine_audio_monitors.h"
 
 extern "C" void GDN_EXPORT godot_gdnative_init(godot_gdnative_init_options *o) {
 	godot::Godot::gdnative_init(o);
@@ -22,4 +25,7 @@ extern "C" void GDN_EXPORT godot_nativescript_init(void *handle) {
 	godot::register_class<godot::EngineAudioRecorder>();
 	godot::register_class<godot::ProceduralEngineAudioGenerator>();
 	godot::register_class<godot::EngineAudioPlayer>();
+	godot::register_class<godot::EngineRenderScheduler>();
+	godot::register_class<godot::EngineAudioHybrid>();
+	godot::register_class<godot::EngineAudioMonitors>();
 }
\ No newline at end of file
@@ -0,0 +1,238 @@
+// Golden output regression check. Renders every preset at fixed rpm points with fixed
+// noise seeds and compares against the reference renders in golden/, so optimized
+// kernels can be verified against the output they replace.
+//
+//   engine_golden [--update] [--filter <text>] [--presets <dir>] [--golden <dir>]
+//
+// Goldens are raw little endian float32, GOLDEN_FRAMES per rpm point in GOLDEN_RPMS
+// order. golden/tolerances.txt holds "<preset> <max abs error>" lines, "default" sets
+// the tolerance of presets not listed.
+
+#include "engine_synth.h"
+#include "engine_preset.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <dirent.h>
+
+#define GOLDEN_WARMUP_FRAMES 4096
+#define GOLDEN_FRAMES 1024
+#define GOLDEN_INTAKE_SEED 1
+#define GOLDEN_CRANKSHAFT_SEED 2
+#define GOLDEN_DEFAULT_TOLERANCE 1e-4f
+
+static const float GOLDEN_RPMS[] = {800.f, 2500.f, 6000.f};
+static const uint32_t GOLDEN_RPM_COUNT = sizeof(GOLDEN_RPMS) / sizeof(GOLDEN_RPMS[0]);
+
+static void print_usage() {
+	fprintf(stderr, "usage: engine_golden [--update] [--filter <text>] [--presets <dir>] [--golden <dir>]\n");
+}
+
+// Every rpm point starts from a cleared engine, so an error can't carry over
+static bool render_preset(EnginePreset &p_preset, std::vector<float> &r_output) {
+	p_preset.params.intake_noise_seed = GOLDEN_INTAKE_SEED;
+	p_preset.params.crankshaft_noise_seed = GOLDEN_CRANKSHAFT_SEED;
+
+	EngineSynth synth;
+	synth.background_rebuild = false;
+	p_preset.apply(&synth);
+
+	if (!synth.update_engine()) {
+		return false;
+	}
+
+	std::vector<float> warmup(GOLDEN_WARMUP_FRAMES);
+	r_output.resize(GOLDEN_RPM_COUNT * GOLDEN_FRAMES);
+
+	for (uint32_t i = 0; i < GOLDEN_RPM_COUNT; i++) {
+		synth.controls->set_rpm(GOLDEN_RPMS[i]);
+		synth.clear_buffer();
+		synth.fill_buffer(warmup.data(), GOLDEN_WARMUP_FRAMES, 1);
+		synth.fill_buffer(r_output.data() + i * GOLDEN_FRAMES, GOLDEN_FRAMES, 1);
+	}
+
+	return true;
+}
+
+static bool read_floats(const std::string &p_path, std::vector<float> &r_values) {
+	FILE *file = fopen(p_path.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+
+	r_values.clear();
+	float chunk[1024];
+	size_t read;
+	while ((read = fread(chunk, sizeof(float), 1024, file)) > 0) {
+		r_values.insert(r_values.end(), chunk, chunk + read);
+	}
+
+	fclose(file);
+	return true;
+}
+
+static bool write_floats(const std::string &p_path, const std::vector<float> &p_values) {
+	FILE *file = fopen(p_path.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+
+	bool written = fwrite(p_values.data(), sizeof(float), p_values.size(), file) == p_values.size();
+	fclose(file);
+	return written;
+}
+
+static std::map<std::string, float> read_tolerances(const std::string &p_path, float &r_default) {
+	std::map<std::string, float> tolerances;
+
+	FILE *file = fopen(p_path.c_str(), "r");
+	if (!file) {
+		return tolerances;
+	}
+
+	char line[256];
+	while (fgets(line, sizeof(line), file)) {
+		char name[128];
+		float tolerance;
+		if (line[0] == '#' || sscanf(line, "%127s %f", name, &tolerance) != 2) {
+			continue;
+		}
+
+		if (strcmp(name, "default") == 0) {
+			r_default = tolerance;
+		} else {
+			tolerances[name] = tolerance;
+		}
+	}
+
+	fclose(file);
+	return tolerances;
+}
+
+int main(int argc, char **argv) {
+	bool update = false;
+	std::string filter;
+	std::string presets = "project/Engines";
+	std::string golden = "golden";
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--update") == 0) {
+			update = true;
+			continue;
+		}
+
+		if (i + 1 >= argc) {
+			print_usage();
+			return 1;
+		}
+
+		if (strcmp(argv[i], "--filter") == 0) {
+			filter = argv[++i];
+		} else if (strcmp(argv[i], "--presets") == 0) {
+			presets = argv[++i];
+		} else if (strcmp(argv[i], "--golden") == 0) {
+			golden = argv[++i];
+		} else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	DIR *dir = opendir(presets.c_str());
+	if (!dir) {
+		fprintf(stderr, "can't open %s\n", presets.c_str());
+		return 1;
+	}
+
+	std::vector<std::string> files;
+	while (dirent *entry = readdir(dir)) {
+		std::string file = entry->d_name;
+		if (file.size() > 5 && file.compare(file.size() - 5, 5, ".tres") == 0) {
+			files.push_back(file);
+		}
+	}
+	closedir(dir);
+	std::sort(files.begin(), files.end());
+
+	float default_tolerance = GOLDEN_DEFAULT_TOLERANCE;
+	std::map<std::string, float> tolerances = read_tolerances(golden + "/tolerances.txt", default_tolerance);
+
+	uint32_t checked = 0;
+	uint32_t failed = 0;
+
+	for (const std::string &file : files) {
+		std::string name = file.substr(0, file.size() - 5);
+		if (!filter.empty() && name.find(filter) == std::string::npos) {
+			continue;
+		}
+
+		EnginePreset preset;
+		std::string error;
+		std::vector<float> output;
+
+		if (!engine_preset_load((presets + "/" + file).c_str(), preset, error) || !render_preset(preset, output)) {
+			printf("%-12s FAIL  %s\n", name.c_str(), error.empty() ? "the engine could not be built" : error.c_str());
+			failed++;
+			continue;
+		}
+
+		std::string path = golden + "/" + name + ".f32";
+
+		if (update) {
+			if (!write_floats(path, output)) {
+				printf("%-12s FAIL  can't write %s\n", name.c_str(), path.c_str());
+				failed++;
+			} else {
+				printf("%-12s updated\n", name.c_str());
+			}
+			continue;
+		}
+
+		std::vector<float> reference;
+		if (!read_floats(path, reference) || reference.size() != output.size()) {
+			printf("%-12s FAIL  %s is missing or has the wrong length\n", name.c_str(), path.c_str());
+			failed++;
+			continue;
+		}
+
+		std::map<std::string, float>::const_iterator it = tolerances.find(name);
+		float tolerance = it != tolerances.end() ? it->second : default_tolerance;
+
+		// Max error decides, the signal to error ratio shows how far off it is
+		double max_error = 0.0;
+		double signal = 0.0;
+		double noise = 0.0;
+		uint32_t worst = 0;
+
+		for (uint32_t i = 0; i < output.size(); i++) {
+			double diff = std::fabs((double)output[i] - (double)reference[i]);
+			if (!(diff <= max_error)) {
+				max_error = diff;
+				worst = i;
+			}
+			signal += (double)reference[i] * reference[i];
+			noise += diff * diff;
+		}
+
+		double snr = noise > 0.0 ? 10.0 * std::log10(signal / noise) : INFINITY;
+		bool passed = max_error <= tolerance;
+
+		printf("%-12s %s  max error %.3g at rpm %g frame %u, tolerance %.3g, snr %.1f dB\n",
+			name.c_str(), passed ? "ok  " : "FAIL", max_error,
+			GOLDEN_RPMS[worst / GOLDEN_FRAMES], worst % GOLDEN_FRAMES, tolerance, snr);
+
+		checked++;
+		failed += passed ? 0 : 1;
+	}
+
+	if (!update) {
+		printf("%u checked, %u failed\n", checked, failed);
+	}
+
+	return failed > 0 ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+// Checks that engine_bank_validate accepts a well formed bank and rejects corrupted ones.
+// The header checksum is recomputed after each corruption, it is no protection against
+// a crafted file. Exits non zero when a case fails.
+//
+//   engine_bank_test
+
+#include "engine_bank_file.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#define TEST_FRAMES 64
+
+// A PCM bank holding one sample, padded to a 4 KiB buffer
+static std::vector<uint8_t> make_bank() {
+	EngineBankHeader header;
+	engine_bank_init_header(header, 44100, 1, 1, TEST_FRAMES);
+
+	std::vector<uint8_t> data(4096, 0);
+
+	EngineBankIndexEntry entry;
+	entry.rpm = 1000.f;
+	entry.start = 0;
+	entry.end = TEST_FRAMES;
+	entry.block = 0;
+	memcpy(data.data() + header.index_offset, &entry, sizeof(entry));
+
+	for (int i = 0; i < ENGINE_BANK_STEMS; i++) {
+		int16_t *frames = (int16_t *)(data.data() + header.stem_offsets[i]);
+		for (uint32_t j = 0; j < TEST_FRAMES; j++) {
+			frames[j] = (int16_t)(j * 100 * (i + 1));
+		}
+	}
+
+	memcpy(data.data(), &header, sizeof(header));
+	return data;
+}
+
+// Signs a modified header the way a crafted file would. The index bounds are checked
+// before the checksum, so a header whose index doesn't fit is left unsigned.
+static void sign(std::vector<uint8_t> &p_data) {
+	EngineBankHeader *header = (EngineBankHeader *)p_data.data();
+	uint64_t index_size = (uint64_t)header->sample_count * sizeof(EngineBankIndexEntry);
+	if (header->index_offset > p_data.size() || index_size > p_data.size() - header->index_offset) {
+		return;
+	}
+
+	const EngineBankIndexEntry *index = (const EngineBankIndexEntry *)(p_data.data() + header->index_offset);
+	header->header_checksum = engine_bank_header_checksum(*header, index);
+}
+
+static int failures = 0;
+
+static void expect(const char *p_name, const std::vector<uint8_t> &p_data, bool p_valid) {
+	bool valid = engine_bank_validate(p_data.data(), p_data.size(), false) != nullptr;
+	printf("%-28s %s\n", p_name, valid == p_valid ? "ok" : "FAIL");
+	if (valid != p_valid) {
+		failures++;
+	}
+}
+
+int main() {
+	std::vector<uint8_t> bank = make_bank();
+	sign(bank);
+	expect("valid", bank, true);
+
+	std::vector<uint8_t> wrapped_stem = make_bank();
+	((EngineBankHeader *)wrapped_stem.data())->stem_offsets[1] = 0xFFFFFFFFFFFFFFC0ull;
+	sign(wrapped_stem);
+	expect("stem offset wraps around", wrapped_stem, false);
+
+	std::vector<uint8_t> stem_past_end = make_bank();
+	((EngineBankHeader *)stem_past_end.data())->stem_offsets[2] = 4096 - 64;
+	sign(stem_past_end);
+	expect("stem past the end", stem_past_end, false);
+
+	std::vector<uint8_t> wrapped_index = make_bank();
+	((EngineBankHeader *)wrapped_index.data())->index_offset = 0xFFFFFFFFFFFFFFF0ull;
+	sign(wrapped_index);
+	expect("index offset wraps around", wrapped_index, false);
+
+	std::vector<uint8_t> long_index = make_bank();
+	((EngineBankHeader *)long_index.data())->sample_count = 0xFFFFFFFFu;
+	sign(long_index);
+	expect("index past the end", long_index, false);
+
+	printf("%d failed\n", failures);
+	return failures > 0 ? 1 : 0;
+}
\ No newline at end of file